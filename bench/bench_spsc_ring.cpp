@@ -0,0 +1,128 @@
+// Handoff latency of SpscRing against the std::queue + mutex + condition_variable
+// queues it replaced. Two threads play ping-pong through a pair of queues: every
+// item is handed over to a consumer already waiting for it, as the decoder and the
+// display thread do frame after frame. A round trip is two handoffs.
+#include "spsc_ring.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// The previous handoff, as the video player had it: one mutex and one condition
+// variable per queue, notified under the lock after each push and pop.
+template <typename T>
+class MutexQueue {
+public:
+    explicit MutexQueue(size_t capacity) : capacity(capacity) {}
+
+    void push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [&]() { return items.size() < capacity; });
+        items.push(std::move(item));
+        cv.notify_one();
+    }
+    void pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [&]() { return !items.empty(); });
+        item = std::move(items.front());
+        items.pop();
+        cv.notify_one();
+    }
+
+private:
+    size_t capacity;
+    std::queue<T> items;
+    std::mutex mtx;
+    std::condition_variable cv;
+};
+
+// Same interface over SpscRing, never stopped.
+template <typename T>
+class RingQueue {
+public:
+    explicit RingQueue(size_t capacity) : ring(capacity) {}
+
+    void push(T item) { ring.push(item, []() { return false; }); }
+    void pop(T& item) { ring.pop(item, []() { return false; }); }
+
+private:
+    SpscRing<T> ring;
+};
+
+struct Result {
+    double median;
+    double p99;
+    double mean;
+};
+
+// Nanoseconds per handoff (half a round trip) over "rounds" round trips.
+template <typename Queue>
+Result pingPong(size_t rounds, size_t capacity)
+{
+    Queue ping(capacity), pong(capacity);
+    std::thread echo([&]() {
+        uint64_t value = 0;
+        for (size_t i = 0; i < rounds; ++i) {
+            ping.pop(value);
+            pong.push(value + 1);
+        }
+    });
+
+    std::vector<double> samples(rounds);
+    uint64_t value = 0;
+    Clock::time_point begin = Clock::now();
+    for (size_t i = 0; i < rounds; ++i) {
+        Clock::time_point start = Clock::now();
+        ping.push(value);
+        pong.pop(value);
+        samples[i] = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / 2;
+    }
+    double total = std::chrono::duration<double, std::nano>(Clock::now() - begin).count();
+    echo.join();
+    if (value != rounds) std::fprintf(stderr, "lost items: %llu of %zu\n", static_cast<unsigned long long>(value), rounds);
+
+    std::sort(samples.begin(), samples.end());
+    return {samples[samples.size() / 2], samples[samples.size() * 99 / 100], total / rounds / 2};
+}
+
+void report(const char* name, const Result& result)
+{
+    std::printf("%-28s %10.0f %10.0f %10.0f\n", name, result.median, result.p99, result.mean);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    size_t rounds = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    if (rounds == 0) rounds = 1;
+    // 10: the packet and frame queues of the video player
+    const size_t capacities[] = {1, 10};
+
+    std::printf("%zu round trips, ns per handoff\n", rounds);
+    std::printf("%-28s %10s %10s %10s\n", "", "median", "p99", "mean");
+    for (size_t capacity : capacities) {
+        char name[64];
+        // Warm up both (threads, page faults, CPU frequency) before measuring.
+        pingPong<MutexQueue<uint64_t>>(rounds / 10 + 1, capacity);
+        pingPong<RingQueue<uint64_t>>(rounds / 10 + 1, capacity);
+        std::snprintf(name, sizeof(name), "mutex + cv, capacity %zu", capacity);
+        report(name, pingPong<MutexQueue<uint64_t>>(rounds, capacity));
+        std::snprintf(name, sizeof(name), "SpscRing, capacity %zu", capacity);
+        report(name, pingPong<RingQueue<uint64_t>>(rounds, capacity));
+    }
+    return 0;
+}
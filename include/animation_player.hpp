@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "st7735s.hpp"
+#include "uni_frame.hpp"
+
+// Animated GIF player. All frames are decoded, scaled and converted to the bus format
+// once in load(); each frame is then kept as the rectangles that changed since the
+// previous one, so playing (and looping) is only the SPI bursts of those rectangles.
+class AnimationPlayer {
+public:
+    struct Stats {
+        uint64_t shown = 0;
+        // Pixel bytes written, the full first frame included
+        uint64_t bytesSent = 0;
+        // Frames shown more than a millisecond after their time
+        uint64_t late = 0;
+    };
+
+    explicit AnimationPlayer(ST7735S& screen);
+    AnimationPlayer(const AnimationPlayer&) = delete;
+    AnimationPlayer& operator=(const AnimationPlayer&) = delete;
+
+    // Decodes "path" and prepares the updates for the current pixel format, nothing is sent.
+    bool load(const std::string& path, uniframe::Orientation orientation);
+    // Blocks until "loops" passes over the frames (0: until stop()) are shown.
+    void play(int loops = 0);
+    // Can be called from any thread.
+    void stop();
+    size_t frameCount() const { return frames.size(); }
+    // Bytes held by the prepared frames
+    size_t sizeBytes() const { return full.size() + payload.size(); }
+    Stats stats();
+
+    // Used for frames without a delay, or a delay too short to be meant (browsers do the same).
+    std::chrono::milliseconds defaultDelay{100};
+
+private:
+    using Clock = std::chrono::steady_clock;
+    // Pixels of "window" (panel coordinates) at "offset" in "payload"
+    struct Update {
+        ST7735S::Window window;
+        size_t offset;
+        size_t len;
+    };
+    // What changes from the previous frame to this one, frame 0 follows the last one.
+    struct Frame {
+        std::vector<Update> updates;
+        std::chrono::milliseconds delay;
+    };
+
+    ST7735S& screen;
+    ST7735S::ImageLayout layout = {};
+    // First frame for the whole window
+    std::vector<uint8_t> full;
+    std::vector<Frame> frames;
+    std::vector<uint8_t> payload;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool running = false;
+    Stats counters;
+
+    bool waitUntil(Clock::time_point when);
+    void showFrame(const Frame& frame);
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+
+#include "st7735s.hpp"
+#include "uni_frame.hpp"
+
+// Persistent cache of panel-ready images, one file per image plus an index.
+// Keys cover the source file (path, size, mtime) and how it is shown
+// (panel size, orientation, pixel format), so a changed file or setting misses.
+//
+// Entry file: EntryHeader, the key, then the pixels at "payloadOffset",
+// ready to be mapped and written to the bus as they are.
+// Index file: IndexHeader then one Record per entry, used for the size cap (LRU).
+// Both are in host byte order, the cache is local to the device.
+class ImageCache {
+public:
+    // A cached image mapped read-only, valid while the object lives.
+    class Mapping {
+    public:
+        ~Mapping();
+        Mapping(const Mapping&) = delete;
+        Mapping& operator=(const Mapping&) = delete;
+        const ST7735S::ImageLayout& layout() const { return imageLayout; }
+        const uint8_t* data() const { return static_cast<const uint8_t*>(base) + offset; }
+        size_t size() const { return length; }
+    private:
+        friend class ImageCache;
+        Mapping() = default;
+        void* base = nullptr;
+        size_t mapped = 0;
+        size_t offset = 0;
+        size_t length = 0;
+        ST7735S::ImageLayout imageLayout = {};
+    };
+
+    // "dir" is created if needed, "maxBytes" caps the entry files together.
+    explicit ImageCache(const std::string& dir, uint64_t maxBytes = 32u << 20);
+    ~ImageCache();
+    ImageCache(const ImageCache&) = delete;
+    ImageCache& operator=(const ImageCache&) = delete;
+
+    // Empty when "path" cannot be stat'ed.
+    static std::string key(const std::string& path, int screenWidth, int screenHeight,
+        uniframe::Orientation orientation, uniframe::PixelFormat format);
+    // nullptr on a miss
+    std::unique_ptr<Mapping> find(const std::string& key);
+    bool store(const std::string& key, const ST7735S::ImageLayout& layout, const uint8_t* data, size_t len);
+    uint64_t sizeBytes();
+
+private:
+    struct EntryHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t keyLength;
+        uint64_t payloadOffset;
+        uint64_t payloadBytes;
+        uint16_t displayWidth;
+        uint16_t displayHeight;
+        uint8_t xS, xE, yS, yE;
+        uint8_t orientation;
+        uint8_t format;
+        uint8_t reserved[6];
+    };
+    struct IndexHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t count;
+        uint64_t clock;
+    };
+    struct Record {
+        uint64_t hash;
+        // Size of the entry file
+        uint64_t bytes;
+        // Value of "clock" at the last find() / store()
+        uint64_t lastUse;
+    };
+
+    std::string dir;
+    uint64_t maxBytes;
+    std::vector<Record> records;
+    uint64_t clock = 0;
+    uint64_t totalBytes = 0;
+    bool dirty = false;
+    std::mutex mtx;
+
+    static uint64_t hashOf(const std::string& key);
+    std::string entryPath(uint64_t hash) const;
+    void loadIndex();
+    void saveIndex();
+    void removeRecord(size_t i);
+    void evict(uint64_t keep);
+};
@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <string>
 #include <vector>
+#include <functional>
 
 namespace imghandler {
 
@@ -12,23 +13,116 @@ struct ImageRGB565 {
     std::vector<uint8_t> data;
 };
 
+// 12 bits per pixel, two pixels packed in three bytes: R1G1 B1R2 G2B2
+struct ImageRGB444 {
+    int width;
+    int height;
+    std::vector<uint8_t> data;
+};
+
 struct ImageRGB24 {
     int width;
     int height;
     std::vector<uint8_t> data;
 };
 
+// Frames of an animation, composited (disposal applied) and stored back to back.
+struct AnimationRGB24 {
+    int width;
+    int height;
+    std::vector<uint8_t> data;
+    // Display time of each frame, in milliseconds
+    std::vector<int> delays;
+};
+
 enum class ImageType {
     PNG,
-    JPG
+    JPG,
+    BMP,
+    GIF,
+    WEBP,
+    Unknown
+};
+
+// Read-only mapping of a whole file, the loaders decode straight from it.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    bool open(const std::string& path);
+    void close();
+    const uint8_t* data() const { return base; }
+    size_t size() const { return length; }
+private:
+    const uint8_t* base = nullptr;
+    size_t length = 0;
 };
 
+// From the file signature, throws when the file cannot be opened.
 ImageType formatProbe(const std::string& path);
 
-bool decodeJpegToRGB24(const std::string& filename, ImageRGB24& image);
+// Decoders write into "image.data", which keeps its capacity:
+// passing the same image again decodes without allocating.
+
+// With a box ("boxWidth" * "boxHeight", the panel), the JPEG is decoded at the
+// smallest DCT scaling still at least as large as the image fitted in the box.
+bool decodeJpegToRGB24(const std::string& filename, ImageRGB24& image, int boxWidth = 0, int boxHeight = 0);
+bool decodeJpegToRGB24(const uint8_t* jpeg, size_t len, ImageRGB24& image, int boxWidth = 0, int boxHeight = 0);
+// Embedded thumbnail (APP1 / EXIF, IFD1) of a JPEG in memory, "thumb" points into "jpeg".
+bool extractExifThumbnail(const uint8_t* jpeg, size_t len, const uint8_t*& thumb, size_t& thumbLen);
+// Decodes the EXIF thumbnail, false when there is none or it is smaller than the image fitted in the box.
+bool decodeExifThumbnailToRGB24(const std::string& filename, ImageRGB24& image, int boxWidth, int boxHeight);
 bool decodePngToRGB24(const std::string& filename, ImageRGB24& image);
 bool decodeImageToRGB24(const std::string& filename, ImageRGB24& image);
+// Every frame of a GIF at once, a still GIF gives one frame.
+bool decodeGifToRGB24(const std::string& filename, AnimationRGB24& animation);
+
+// Box filter scaler fed one RGB24 source row at a time, top to bottom.
+// Each output pixel averages the source pixels it covers; finished output
+// rows are handed to "emitRow", memory stays at one output row.
+class RowScaler {
+public:
+    using EmitRow = std::function<void(int y, const uint8_t* rgb24)>;
+    RowScaler(int srcWidth, int srcHeight, int dstWidth, int dstHeight, EmitRow emitRow);
+    void pushRow(const uint8_t* rgb24);
+private:
+    int srcHeight;
+    int dstWidth;
+    int dstHeight;
+    EmitRow emitRow;
+    std::vector<int> xBegin;
+    std::vector<int> xEnd;
+    std::vector<uint32_t> acc;
+    std::vector<uint8_t> row;
+    int srcY = 0;
+    int dstY = 0;
+    int rowBegin(int y) const;
+    int rowEnd(int y) const;
+};
+
+// Size of the output for a "width" * "height" source, false to abort the decode.
+using TargetSize = std::function<bool(int width, int height, int& dstWidth, int& dstHeight)>;
+
+// Streams a JPEG through the libjpeg scanline API, a strip of rows at a time, into a RowScaler.
+// The DCT scaling is chosen as close to the target as possible. Memory stays at
+// a strip and one output row whatever the image size, the rows go to "emitRow".
+bool decodeJpegStreaming(const uint8_t* jpeg, size_t len, const TargetSize& targetSize, const RowScaler::EmitRow& emitRow);
+bool decodeJpegStreaming(const std::string& filename, const TargetSize& targetSize, const RowScaler::EmitRow& emitRow);
+// Same for PNG through libpng: 16 bits, palette, gray and alpha are reduced to RGB24 while reading.
+// Interlaced PNGs need the whole image and are refused (false), stb_image takes them.
+bool decodePngStreaming(const uint8_t* png, size_t len, const TargetSize& targetSize, const RowScaler::EmitRow& emitRow);
+bool decodePngStreaming(const std::string& filename, const TargetSize& targetSize, const RowScaler::EmitRow& emitRow);
+
+// Fused scale + convert in one pass over the source, output ready for the panel.
+bool scaleToRGB565(const ImageRGB24& src, ImageRGB565& dst, int targetWidth, int targetHeight);
+bool scaleToRGB444(const ImageRGB24& src, ImageRGB444& dst, int targetWidth, int targetHeight);
 
 bool convertToRGB565(const ImageRGB24& src, ImageRGB565& dst);
+bool convertToRGB444(const ImageRGB24& src, ImageRGB444& dst);
+// Pack RGB24 rows into one continuous RGB444 stream, a pair may span two rows.
+// "dst" holds (width * height + 1) / 2 * 3 bytes.
+void packRGB24ToRGB444(const uint8_t* src, size_t srcStride, int width, int height, uint8_t* dst);
 bool scaleImage(const ImageRGB24& src, ImageRGB24& dst, int targetWidth, int targetHeight);
 }
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "st7735s.hpp"
+
+// Several ST7735S panels updated together.
+// Each SPI bus gets one worker, panels sharing a bus (different chip selects)
+// are interleaved a few KB at a time so none of them waits for a whole frame of another.
+// Panels in a group must not be in async mode.
+class PanelGroup {
+public:
+    struct Frame {
+        const uint8_t* data;
+        size_t len;
+    };
+
+    PanelGroup() = default;
+    ~PanelGroup();
+    PanelGroup(const PanelGroup&) = delete;
+    PanelGroup& operator=(const PanelGroup&) = delete;
+
+    // Bus number of a spidev node, "/dev/spidev3.1" -> 3, -1 if unknown
+    static int busOf(const std::string& spi_dev);
+    // Returns the index of the panel in present()
+    size_t addPanel(ST7735S& panel, int bus);
+    // Start writing "frames[i]" to panel i on all buses at once and return.
+    // Waits for the previous present() first, the data must stay valid until wait().
+    // Every frame is cut into the same number of rounds (at most "quantum" bytes a piece)
+    // and no bus starts a round before the others finished the previous one, so the
+    // panels finish within about one round of each other, whatever the frame sizes.
+    void present(const std::vector<Frame>& frames);
+    void wait();
+    // Spread between the first and the last panel finishing the last present(), call after wait()
+    int64_t lastSkewUs() const;
+
+    // Largest piece of a frame sent before the next panel of the bus gets its turn,
+    // capped by the SPI message limit. Fixed rather than the (often frame sized) bufsiz,
+    // a round on a bus is "panels on it * quantum" bytes: 1 ms for two panels at 32 MHz.
+    size_t quantum = 2048;
+
+private:
+    using Clock = std::chrono::steady_clock;
+    struct Panel {
+        ST7735S* screen;
+        int bus;
+        Frame frame;
+        size_t offset;
+        // Bytes sent per round, the last round gets the rest.
+        size_t share;
+        Clock::time_point done;
+    };
+    struct Bus {
+        int id;
+        std::vector<size_t> panels;
+        // First panel of the next present(), rotated for fairness.
+        size_t rotation = 0;
+        // Rounds of the current present() written, under "mtx".
+        size_t roundsDone = 0;
+        std::thread worker;
+    };
+
+    std::vector<Panel> panels;
+    std::vector<std::unique_ptr<Bus>> buses;
+    std::mutex mtx;
+    std::condition_variable cv;
+    uint64_t generation = 0;
+    size_t rounds = 0;
+    size_t busesPending = 0;
+    bool running = false;
+
+    void loopBus(Bus& bus);
+    void writeBus(Bus& bus);
+    // Wait until no bus is behind "round", false once stopped.
+    bool awaitRound(size_t round);
+    void finishRound(Bus& bus, size_t round);
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+
+// Command tables played by ST7735S::playTable().
+// Steps are streamed in order, a "delayMs" holds the next command back
+// (on top of the datasheet settling the command scheduler already knows).
+namespace paneltable {
+
+struct Step {
+    uint8_t cmd;
+    uint8_t len;
+    uint8_t data[16];
+    uint16_t delayMs;
+};
+
+struct Table {
+    const Step* steps;
+    size_t count;
+};
+
+// Panel Resolution Select:
+// GM2=0 GM1=1 GM0=1
+// 128RGB * 160 (S7~390 and G2~161 output)
+// S:LCD Source Driver[396:1]
+// G:LCD Gate   Driver[162:1]
+inline constexpr Step initST7735SSteps[] = {
+    {0x11, 0, {}, 0},                    // Sleep out
+    {0x3A, 1, {0x55}, 0},                // Pixel Format: RGB565
+    {0x26, 1, {0x03}, 0},                // Gamma select
+    // FPS formula: fps = 200kHz/(line+VPA[5:0])(DIVA[4:0]+4)
+    // when GM = 011(128*160), line = 160
+    {0xB1, 2, {0x06, 0x0A}, 0},          // FPS normal mode, fps: 117
+    {0xB2, 2, {0x06, 0x0A}, 0},          // FPS idle mode, fps: 117
+    {0xB3, 2, {0x06, 0x0A}, 0},          // FPS partial mode, fps: 117
+    {0xB4, 1, {0x02}, 0},                // Display Inversion Control (refresh by line or frame)
+    {0xC0, 2, {0x0A, 0x02}, 0},          // Power control: GVDD and voltage
+    {0xC1, 1, {0x02}, 0},                // Power control: AVDD, VCL, VGH and VGL supply power level
+    {0xC5, 2, {0x4F, 0x5A}, 0},          // Power control: Set VCOMH, VCOML Voltage
+    {0xC7, 1, {0x40}, 0},                // VCOM Offset Control
+    {0x36, 1, {0x00}, 0},                // Memory access control: RGB order
+    {0xB7, 1, {0x00}, 0},                // Source Driver Direction Control
+    {0xB8, 1, {0x00}, 0},                // Gate Driver Direction Control
+    // Commands without parameters are adjacent so they share one message.
+    {0x20, 0, {}, 0},                    // Inversion off
+    {0x38, 0, {}, 0},                    // Idle mode off
+    {0x29, 0, {}, 0},                    // Display on
+};
+inline constexpr Table initST7735S = {initST7735SSteps, std::size(initST7735SSteps)};
+
+inline constexpr Step gammaST7735SSteps[] = {
+    {0xF2, 0, {}, 0},                    // Enable Gamma correction
+    {0xE0, 15, {0x3F, 0x25, 0x1C, 0x1E, 0x20, 0x12, 0x2A, 0x90,
+                0x24, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00}, 0},   // Positive Gamma correction
+    {0xE1, 15, {0x20, 0x20, 0x20, 0x20, 0x05, 0x00, 0x15, 0xA7,
+                0x3D, 0x18, 0x25, 0x2A, 0x2B, 0x2B, 0x3A}, 0},   // Negative Gamma correction
+};
+inline constexpr Table gammaST7735S = {gammaST7735SSteps, std::size(gammaST7735SSteps)};
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "st7735s.hpp"
+
+// Sends only the changed areas of a frame to the panel.
+// A shadow copy of the window content is kept, changes are detected on a
+// tile grid and merged into a few rectangles. Each rectangle costs an extra
+// CASET/RASET/RAMWR sequence, so merging is driven by a byte cost model.
+class PartialUpdater {
+public:
+    struct Rect { int x; int y; int width; int height; };
+
+    explicit PartialUpdater(ST7735S& screen, int bytesPerPixel = 2);
+
+    // Forget the shadow copy, the next frame is sent entirely.
+    void invalidate();
+    // "frame" covers the current screen window, rows are "stride" bytes apart.
+    // Returns the number of pixel bytes sent.
+    size_t present(const uint8_t* frame, size_t stride);
+    const std::vector<Rect>& lastRects() const { return rects; }
+    // Change detection alone: rectangles of "frame" ("frameWidth" * "frameHeight") differing
+    // from the previous call, nothing is sent. The first call returns the whole frame.
+    const std::vector<Rect>& track(const uint8_t* frame, size_t stride, int frameWidth, int frameHeight);
+
+    // Side of the square tiles used for change detection, in pixels.
+    int tileSize = 8;
+    // Upper limit of rectangles sent for one frame.
+    size_t maxRects = 16;
+    // Cost of one window change expressed in pixel bytes: the CASET/RASET/RAMWR
+    // bytes plus the syscalls and D/C toggles of the extra messages.
+    size_t windowCostBytes = 256;
+
+private:
+    ST7735S& screen;
+    int bytesPerPixel;
+    ST7735S::Window window = {};
+    int width = 0;
+    int height = 0;
+    bool valid = false;
+    std::vector<uint8_t> shadow;
+    std::vector<uint8_t> tiles;
+    std::vector<Rect> rects;
+    std::vector<uint8_t> scratch;
+
+    size_t cost(const Rect& rect) const;
+    static Rect unite(const Rect& a, const Rect& b);
+    void detect(const uint8_t* frame, size_t stride);
+    void merge();
+    void send(const Rect& rect);
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Pixel conversion kernels used on the hot paths.
+// The fastest implementation (AVX2, SSE2/SSSE3, NEON) is picked once at start-up
+// from the CPU features, the scalar versions are the reference they must match bit for bit.
+namespace pixkernel {
+
+// RGB888 (R, G, B bytes) -> RGB565, big-endian is the order the panel expects
+void rgb888ToRGB565BE(const uint8_t* src, uint8_t* dst, size_t pixels);
+void rgb888ToRGB565LE(const uint8_t* src, uint8_t* dst, size_t pixels);
+// RGBA (R, G, B, A bytes) -> big-endian RGB565, alpha is ignored
+void rgbaToRGB565BE(const uint8_t* src, uint8_t* dst, size_t pixels);
+// Swap the bytes of "count" 16 bits words, "src" and "dst" may be the same buffer
+void byteswap16(const uint8_t* src, uint8_t* dst, size_t count);
+// Repeat "pattern" over "len" bytes, the last copy may be cut short
+void fill(uint8_t* dst, size_t len, const uint8_t* pattern, size_t patternLen);
+
+// Name of the implementation in use, e.g. "avx2"
+const char* active();
+
+// One implementation of every kernel
+struct Kernels {
+    const char* name;
+    void (*rgb888ToRGB565BE)(const uint8_t*, uint8_t*, size_t);
+    void (*rgb888ToRGB565LE)(const uint8_t*, uint8_t*, size_t);
+    void (*rgbaToRGB565BE)(const uint8_t*, uint8_t*, size_t);
+    void (*byteswap16)(const uint8_t*, uint8_t*, size_t);
+    void (*fill)(uint8_t*, size_t, const uint8_t*, size_t);
+};
+// Implementations this CPU can run, scalar first; the last one is in use.
+const std::vector<Kernels>& available();
+
+namespace scalar {
+void rgb888ToRGB565BE(const uint8_t* src, uint8_t* dst, size_t pixels);
+void rgb888ToRGB565LE(const uint8_t* src, uint8_t* dst, size_t pixels);
+void rgbaToRGB565BE(const uint8_t* src, uint8_t* dst, size_t pixels);
+void byteswap16(const uint8_t* src, uint8_t* dst, size_t count);
+void fill(uint8_t* dst, size_t len, const uint8_t* pattern, size_t patternLen);
+}
+
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "st7735s.hpp"
+#include "image_cache.hpp"
+
+// Images shown one after another, "dwell" apart.
+// A pool of workers prepares the next images (decode, scale, convert) ahead of time,
+// so a transition is only the SPI burst of an image already in the bus format.
+class Slideshow {
+public:
+    struct Options {
+        std::chrono::milliseconds dwell{5000};
+        // Images prepared ahead of the one on screen
+        size_t prefetch = 3;
+        size_t workers = 2;
+        // Bytes of prepared images held at once, at least one image is always allowed
+        size_t memoryBudget = 1 << 20;
+        // Start over after the last image
+        bool loop = true;
+        uniframe::Orientation orientation = uniframe::Orientation::Landscape;
+        // Optional, not owned
+        ImageCache* cache = nullptr;
+    };
+    struct Stats {
+        uint64_t shown = 0;
+        uint64_t failed = 0;
+        // Transitions later than their schedule, the image was not ready in time.
+        uint64_t late = 0;
+        int64_t maxLateUs = 0;
+    };
+
+    Slideshow(ST7735S& screen, std::vector<std::string> paths, const Options& options);
+    ~Slideshow();
+    Slideshow(const Slideshow&) = delete;
+    Slideshow& operator=(const Slideshow&) = delete;
+
+    // Image files of a directory sorted by name, or the lines of a list file.
+    static std::vector<std::string> loadList(const std::string& path);
+    // Blocks until the end of the list (without loop) or stop().
+    void run();
+    // Can be called from any thread.
+    void stop();
+    Stats stats();
+
+private:
+    using Clock = std::chrono::steady_clock;
+    enum class SlotState {
+        Working,
+        Ready,
+        Failed
+    };
+    // One upcoming image, "seq" counts images shown since run() (wraps around "paths").
+    struct Slot {
+        uint64_t seq;
+        SlotState state;
+        ST7735S::PreparedImage image;
+        // Counted in "bytesHeld", a full screen while being prepared.
+        size_t bytes;
+    };
+
+    ST7735S& screen;
+    std::vector<std::string> paths;
+    Options options;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<std::thread> workers;
+    // In "seq" order, the front is the next image to show.
+    std::deque<Slot> slots;
+    uint64_t nextJob = 0;
+    uint64_t nextShow = 0;
+    size_t bytesHeld = 0;
+    bool running = false;
+    Stats counters;
+
+    uint64_t endSeq() const;
+    size_t reserveBytes() const;
+    bool canClaim() const;
+    void loopWorker();
+    bool prepare(const std::string& path, ST7735S::PreparedImage& image);
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "transport.hpp"
+
+// Linux spidev plus two libgpiod output lines. libgpiod stays out of this header,
+// only spidev_transport.cpp (and the link of bin/player) needs it.
+class SpidevTransport : public Transport {
+public:
+    // "spi_dev" should be like: "/dev/spidev3.0"
+    // "gpio_chip_*" refers to the gpiochip of the pin, should be like: "gpiochip0"
+    // "gpio_offset_*" refers to the offset of the pin
+    SpidevTransport(const std::string& spi_dev,
+        const std::string& gpio_chip_name_rst,
+        const uint8_t gpio_offset_rst,
+        const std::string& gpio_chip_name_dc,
+        const uint8_t gpio_offset_dc,
+        uint32_t speed);
+    ~SpidevTransport() override;
+    void setRST(bool level) override;
+    void setDC(bool level) override;
+    void transfer(const spi_ioc_transfer* segments, size_t count) override;
+    size_t maxTransferSize() const override { return bufsiz; }
+private:
+    struct Lines;
+    std::unique_ptr<Lines> lines;
+    int spi_fd;
+    uint32_t speed;
+    // spidev rejects messages longer than its "bufsiz" module parameter.
+    size_t bufsiz = 4096;
+    // 0 when the probe fails for another reason than the message size.
+    size_t detectBufsiz();
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Futex wrappers on a 32 bits atomic word.
+namespace spsc {
+// Sleeps while "*word" equals "expected", returns at once otherwise.
+void futexWait(std::atomic<uint32_t>* word, uint32_t expected);
+void futexWake(std::atomic<uint32_t>* word);
+}
+
+// Bounded single producer / single consumer ring, the slots are allocated once.
+// push() / pop() are lock-free; a side only sleeps (futex) when the ring is full / empty,
+// and the other side only makes the wake-up syscall when someone is actually sleeping.
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity) : slots(capacity) {}
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer side, "item" is moved from only on success.
+    bool tryPush(T& item)
+    {
+        size_t tail = tailIndex.load(std::memory_order_relaxed);
+        if (tail - headIndex.load(std::memory_order_acquire) == slots.size()) return false;
+        slots[tail % slots.size()] = std::move(item);
+        tailIndex.store(tail + 1, std::memory_order_release);
+        signal(pushed, consumerWaiting);
+        return true;
+    }
+    // Consumer side
+    bool tryPop(T& item)
+    {
+        size_t head = headIndex.load(std::memory_order_relaxed);
+        if (head == tailIndex.load(std::memory_order_acquire)) return false;
+        item = std::move(slots[head % slots.size()]);
+        headIndex.store(head + 1, std::memory_order_release);
+        signal(popped, producerWaiting);
+        return true;
+    }
+    // Blocking versions: wait for room / an item, false once "stop()" is true.
+    // "stop" is checked again after wake(), the caller sets its flag then calls wake().
+    template <typename Stop>
+    bool push(T& item, Stop stop)
+    {
+        while (!tryPush(item)) {
+            if (!wait(popped, producerWaiting, [&]() { return full(); }, stop)) return false;
+        }
+        return true;
+    }
+    template <typename Stop>
+    bool pop(T& item, Stop stop)
+    {
+        while (!tryPop(item)) {
+            if (!wait(pushed, consumerWaiting, [&]() { return empty(); }, stop)) return false;
+        }
+        return true;
+    }
+    // Wake both sides up to check their "stop" condition.
+    void wake()
+    {
+        pushed.fetch_add(1);
+        popped.fetch_add(1);
+        spsc::futexWake(&pushed);
+        spsc::futexWake(&popped);
+    }
+
+    // Approximate when called from a third thread
+    bool empty() const { return headIndex.load(std::memory_order_acquire) == tailIndex.load(std::memory_order_acquire); }
+    bool full() const { return size() == slots.size(); }
+    size_t size() const { return tailIndex.load(std::memory_order_acquire) - headIndex.load(std::memory_order_acquire); }
+    size_t capacity() const { return slots.size(); }
+    // Only with both sides stopped
+    void clear()
+    {
+        T item;
+        while (tryPop(item)) item = T();
+    }
+
+private:
+    std::vector<T> slots;
+    // Monotonic, the slot is "index % capacity"; apart to avoid false sharing.
+    alignas(64) std::atomic<size_t> headIndex{0};
+    alignas(64) std::atomic<size_t> tailIndex{0};
+    // Futex words bumped on each push / pop, and whether the other side sleeps on them.
+    alignas(64) std::atomic<uint32_t> pushed{0};
+    std::atomic<uint32_t> consumerWaiting{0};
+    alignas(64) std::atomic<uint32_t> popped{0};
+    std::atomic<uint32_t> producerWaiting{0};
+
+    static void signal(std::atomic<uint32_t>& word, std::atomic<uint32_t>& waiting)
+    {
+        word.fetch_add(1, std::memory_order_seq_cst);
+        if (waiting.load(std::memory_order_seq_cst)) spsc::futexWake(&word);
+    }
+    // Sleep on "word" unless "blocked()" turned false or "stop()" true meanwhile.
+    template <typename Blocked, typename Stop>
+    bool wait(std::atomic<uint32_t>& word, std::atomic<uint32_t>& waiting, Blocked blocked, Stop stop)
+    {
+        uint32_t seen = word.load(std::memory_order_seq_cst);
+        waiting.store(1, std::memory_order_seq_cst);
+        bool stopped = stop();
+        // A push / pop or wake() since "seen" makes the futex return at once.
+        if (!stopped && blocked() && word.load(std::memory_order_seq_cst) == seen) spsc::futexWait(&word, seen);
+        waiting.store(0, std::memory_order_relaxed);
+        return !stopped;
+    }
+};
@@ -1,46 +1,172 @@
 #pragma once
 
 #include <cstdint>
-#include <gpiod.hpp>
+#include <memory>
 #include <string>
 #include <bitset>
+#include <vector>
+#include <initializer_list>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <linux/spi/spidev.h>
+#include "transport.hpp"
+#include "panel_table.hpp"
 #include "image_handler.hpp"
 #include "uni_frame.hpp"
 
+class ImageCache;
+
 class ST7735S {
 
+public:
+    // A sequence of command / data segments submitted to the bus together.
+    // Consecutive segments with the same D/C level share one SPI message.
+    // Pointer segments are not copied, they must stay valid until submit() returns.
+    class Batch {
+    public:
+        void cmd(uint8_t cmd);
+        void data(const uint8_t* data, size_t len);
+        void data(std::initializer_list<uint8_t> bytes);
+        // Hold the next command back for "ms".
+        void delay(uint16_t ms);
+        void clear();
+        bool empty() const { return segments.empty(); }
+    private:
+        friend class ST7735S;
+        struct Segment {
+            bool isData;
+            // nullptr means the bytes are stored in "inlineBytes" at "offset"
+            const uint8_t* ptr;
+            size_t offset;
+            size_t len;
+            uint16_t delayMs = 0;
+        };
+        std::vector<Segment> segments;
+        std::vector<uint8_t> inlineBytes;
+    };
+
+    // Completion handle of a frame submitted with submitFrame(), 0 is never a valid fence.
+    using Fence = uint64_t;
+
 private:
-    gpiod::line gpio_line_rst;
-    gpiod::line gpio_line_dc;
     // 34000000Hz
     uint32_t speed = 32000000;
-    const size_t maxSPIChunkSize = 4096;
+    std::unique_ptr<Transport> transport;
+    // Longest SPI message, taken from the transport (spidev bufsiz).
+    size_t maxSPIChunkSize = 4096;
+    // SPI_IOC_MESSAGE(N) is limited by the 14 bits ioctl size field.
+    const size_t maxSPISegments = ((1 << _IOC_SIZEBITS) - 1) / sizeof(spi_ioc_transfer);
     // Memory access control
     // D7 D6 D5 D4 D3  D2 D1 D0
     // MY MX MV ML RGB MH  x  x
     std::bitset<8> MADCTL = 0b00000000;
-    int spi_fd;
-    void spiTransfer(bool isData, const uint8_t* data, size_t len);
+    // Interface pixel format (COLMOD)
+    uniframe::PixelFormat pixelFormatBus = uniframe::PixelFormat::RGB565;
+    // Level of the D/C line, -1 before the first transfer.
+    int dcLevel = -1;
+    // Segments of the SPI message being assembled.
+    std::vector<spi_ioc_transfer> transfers;
+    bool transfersIsData = false;
+    size_t transfersLen = 0;
+    // Held for every bus access, so the writer thread and callers do not interleave.
+    std::mutex mtxBus;
+    void spiTransfer(bool isData, const spi_ioc_transfer* segments, size_t count);
+    void queueTransfer(bool isData, const uint8_t* data, size_t len);
+    void flushTransfers();
+    void adaptChunkSize();
+    void reportChunkSize() const;
+    // Command scheduler: earliest time for the next command and for the next SLPIN / SLPOUT.
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point readyAt;
+    Clock::time_point sleepToggleAt;
+    void awaitCommand(uint8_t cmd);
+    void scheduleCommand(uint8_t cmd);
+    void holdBus(uint16_t ms);
     void writeCmd(uint8_t cmd);
     void writeData(uint8_t singleByte);
     void delay_ms(uint64_t ms);
     void gammaCorrect();
     void setMADCTL();
     uint16_t RGB888ToRGB565(uint32_t color);
+
+    // Async mode: ring of frame slots drained by the writer thread.
+    struct FrameSlot {
+        // Frame copy for submitFrame(data, len)
+        std::vector<uint8_t> data;
+        // Rows to write, into "data" or into caller memory
+        const uint8_t* base = nullptr;
+        size_t rowBytes = 0;
+        int rows = 0;
+        size_t stride = 0;
+        Fence fence = 0;
+    };
+    std::vector<FrameSlot> frameSlots;
+    size_t slotHead = 0;
+    size_t slotTail = 0;
+    size_t slotsQueued = 0;
+    Fence fenceSubmitted = 0;
+    std::atomic<Fence> fenceCompleted{0};
+    bool asyncRunning = false;
+    std::thread threadWriter;
+    std::mutex mtxAsync;
+    std::condition_variable cvAsync;
+    void loopWriter();
+    Fence submitSlot(const uint8_t* base, size_t rowBytes, int rows, size_t stride, bool copy);
+
+    // imagePlay(): EXIF thumbnail shortcut and the full decode replacing it in the background.
+    bool exifThumbnails = false;
+    bool exifUpgrade = false;
+    ImageCache* imageCache = nullptr;
+    std::mutex mtxImage;
+    std::condition_variable cvImage;
+    // Bumped by every imagePlay(), a stale upgrade is dropped.
+    uint64_t imageGeneration = 0;
+    std::string upgradePath;
+    std::string upgradeKey;
+    uniframe::Orientation upgradeOrientation = uniframe::Orientation::Portrait;
+    uint64_t upgradeGeneration = 0;
+    bool upgradePending = false;
+    bool upgradeRunning = false;
+    std::thread threadUpgrade;
+    void loopUpgrade();
 public:
     int screenWidth = 128;
     int screenHeight = 160;
     struct DisplayArea{int displayWidth; int displayHeight;} displayArea;
+    // Column / row range last set by rangeSet()
+    struct Window{uint8_t xS; uint8_t xE; uint8_t yS; uint8_t yE;} window = {0, 127, 0, 159};
+    // Where and how a prepared image goes on the panel.
+    struct ImageLayout {
+        uniframe::Orientation orientation;
+        Window window;
+        DisplayArea area;
+        uniframe::PixelFormat format;
+    };
+    // Image ready for the bus: "data" fills "layout.window" in "layout.format".
+    struct PreparedImage {
+        ImageLayout layout;
+        std::vector<uint8_t> data;
+        // Made from the EXIF thumbnail
+        bool thumbnail = false;
+    };
     // "spi_dev" should be like: "/dev/spidev3.0"
     // "gpio_chip_*" refers to the gpiochip of the pin, should be like: "gpiochip0"
     // "gpio_offset_*" refers to the offset of the pin
+    // Defined in spidev_transport.cpp, with the libgpiod code.
     ST7735S(const std::string& spi_dev, 
         const std::string& gpio_chip_name_rst, 
         const uint8_t gpio_offset_rst, 
         const std::string& gpio_chip_name_dc,  
         const uint8_t gpio_offset_dc);
+    // Drive the panel through any bus, e.g. a VirtualPanel.
+    explicit ST7735S(std::unique_ptr<Transport> transport);
     ~ST7735S();
-    void init();
+    // Reset the panel and play the init table.
+    void init(const paneltable::Table& table = paneltable::initST7735S);
+    void playTable(const paneltable::Table& table);
     void reset();
     void colorInversion(bool inversion);
     void sleepMode(bool on);
@@ -49,13 +175,55 @@ public:
     void rangeSet(uint8_t xS, uint8_t xE, uint8_t yS, uint8_t yE);
     void rangeReset();
     void rangeAdapt(int width, int height, uniframe::Orientation orientation);
+    // Centered window of a "width" * "height" image, nothing is sent.
+    Window fitWindow(int width, int height, uniframe::Orientation orientation, DisplayArea& area) const;
     void refreshDirection(bool ml, bool mh);
     void colorOrderRGB(bool RGB);
+    // RGB444 sends 25% less bytes per frame than RGB565.
+    void setPixelFormat(uniframe::PixelFormat format);
+    uniframe::PixelFormat pixelFormat() const { return pixelFormatBus; }
     void orientationSet(uniframe::Orientation orientation);
     void fillWith(uint32_t color_rgb888);
     void clear();
     void imagePlay(std::string& path, uniframe::Orientation orientation);
+    // Show the EXIF thumbnail of JPEGs when it is large enough for the panel,
+    // "upgrade" decodes the full image in the background and draws it over.
+    void useExifThumbnails(bool enable, bool upgrade = true);
+    // Cache of prepared images used by imagePlay(), not owned, nullptr to disable.
+    void setImageCache(ImageCache* cache);
+    // imagePlay() in steps: decode, scale and convert without touching the bus (any thread),
+    // then orientation, window and pixels in one go.
+    bool prepareImage(const std::string& path, uniframe::Orientation orientation, PreparedImage& image, bool exifThumbnail = false) const;
+    bool showImage(const ImageLayout& layout, const uint8_t* data, size_t len);
     void testSetRange();
     void startWrite();
     void writeData(const uint8_t* data, size_t len);
+    void submit(const Batch& batch);
+    // RAMWR and the pixel data in one batch.
+    void writeFrame(const uint8_t* data, size_t len);
+    // "rows" rows of "rowBytes" bytes, "stride" bytes apart, e.g. straight from an AVFrame.
+    // Padded rows become one SPI segment each, nothing is copied.
+    void writeFrame(const uint8_t* base, size_t rowBytes, int rows, size_t stride);
+    size_t chunkSize() const { return maxSPIChunkSize; }
+    // SPI messages needed for "frameBytes" bytes of pixel data.
+    size_t transfersPerFrame(size_t frameBytes) const;
+
+    // Start a writer thread draining "slots" (2 or 3) frame buffers.
+    void enableAsync(size_t slots = 2);
+    // Write the queued frames and stop the writer thread.
+    void disableAsync();
+    // Copy the frame into a free slot and return without waiting for the bus.
+    // Returns 0 when every slot is busy, see waitSlot(). To be called from one thread.
+    // Without async mode the frame is written before returning.
+    Fence submitFrame(const uint8_t* data, size_t len);
+    // Zero-copy variant: the rows are read in place by the writer thread,
+    // the memory must stay valid until the fence is done.
+    Fence submitFrame(const uint8_t* base, size_t rowBytes, int rows, size_t stride);
+    void waitSlot();
+    bool fenceDone(Fence fence) const;
+    void waitFence(Fence fence);
+
+private:
+    // JPEG / PNG decoded in strips straight into the panel format, memory bounded by the output.
+    bool prepareStreaming(const std::string& path, imghandler::ImageType type, PreparedImage& image) const;
 };
\ No newline at end of file
@@ -16,6 +16,8 @@ class TimeSync {
 public:
     void resetPtsBaseUs(us_t ptsUs);
     us_t getFrameTimeUs(us_t ptsUs, double speed);
+    // A base was set, frame times are meaningful.
+    bool started();
 
 private:
     std::mutex mtx;
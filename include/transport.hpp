@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <linux/spi/spidev.h>
+
+// Bus used by ST7735S: a SPI link plus the RST and D/C lines.
+class Transport {
+public:
+    virtual ~Transport() = default;
+    virtual void setRST(bool level) = 0;
+    virtual void setDC(bool level) = 0;
+    // Send "count" segments as one message, "speed_hz" and "tx_buf" of each segment are set by the caller.
+    virtual void transfer(const spi_ioc_transfer* segments, size_t count) = 0;
+    // Longest message (sum of its segments) transfer() accepts, in bytes.
+    virtual size_t maxTransferSize() const = 0;
+};
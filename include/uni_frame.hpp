@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -23,6 +24,15 @@ enum class ImageType {
     JPG
 };
 
+// Pixel format on the SPI bus (COLMOD)
+enum class PixelFormat {
+    RGB565, // 16 bits, 2 bytes per pixel
+    RGB444  // 12 bits, 2 pixels in 3 bytes
+};
+
+// Bytes of "pixels" pixels sent as one stream
+size_t frameBytes(PixelFormat format, size_t pixels);
+
 enum class Orientation {
     Portrait,
     Landscape,
@@ -30,17 +40,4 @@ enum class Orientation {
     LandscapeInverted
 };
 
-// class FramePool {
-// public:
-//     FramePool(size_t maxsize);
-//     ~FramePool();
-
-//     std::unique_ptr<ImageRGB565> acquire();
-//     void release(std::unique_ptr<ImageRGB565> frameRaw);
-
-// private:
-//     std::queue<std::unique_ptr<ImageRGB565>> pool;
-//     std::mutex mtx;
-// };
-
 }
\ No newline at end of file
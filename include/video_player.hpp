@@ -7,24 +7,63 @@
 #include <atomic>
 #include <string>
 #include <chrono>
+#include <memory>
+#include <vector>
 
 #include "uni_frame.hpp"
 #include "st7735s.hpp"
+#include "partial_updater.hpp"
 #include "time_sync.hpp"
+#include "spsc_ring.hpp"
 
 extern "C" {
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
 #include <libavutil/imgutils.h>
+#include <libavutil/buffer.h>
 #include <libswscale/swscale.h>
 #include <libavutil/time.h>
+#include <libavutil/cpu.h>
 }
 
 class VideoPlayer {
 public:
+    struct Stats {
+        uint64_t shown = 0;
+        // Shown after their time, by less than the drop threshold
+        uint64_t late = 0;
+        // Dropped late, before conversion (decoder) or before the bus (display)
+        uint64_t droppedDecode = 0;
+        uint64_t droppedDisplay = 0;
+        // Decoder-side skipping in use, see "skipLevel"
+        int skipLevel = 0;
+        // Frames out of the decoder and the wall time spent in send / receive calls
+        uint64_t decoded = 0;
+        uint64_t decodeUs = 0;
+        // Seeks that reached the panel, time from the request to the first new frame sent
+        uint64_t seeks = 0;
+        us_t seekLatencyUs = 0;
+        us_t maxSeekLatencyUs = 0;
+    };
+    // Software decoder threading, the hardware decoders ignore it.
+    struct DecoderOptions {
+        enum class Threading {
+            Auto,   // what the codec supports, frame threading first
+            Frame,  // one frame per thread, best throughput, a frame of delay per thread
+            Slice   // slices of the same frame, no added delay, needs sliced streams
+        };
+        // 0: one per core
+        int threads = 0;
+        Threading threading = Threading::Auto;
+        // No frame reordering delay: slice threading only, AV_CODEC_FLAG_LOW_DELAY
+        bool lowDelay = false;
+    };
+
     explicit VideoPlayer(ST7735S& screen, uniframe::Orientation orientation);
     ~VideoPlayer();
 
+    // Used by the next load().
+    void setDecoderOptions(const DecoderOptions& options);
     bool load(const std::string& path);
     void play();
     void wait();
@@ -33,8 +72,15 @@ public:
     void seekForward(us_t us);
     void seekBackward(us_t us);
     double setSpeed(double dFactor);
+    // Send only the changed areas of each frame. RGB565 bus only: RGB444 frames are
+    // packed as one stream, turning it on then is refused and returns false.
+    bool setPartialUpdate(bool on);
+    // Drop late frames and let the decoder skip work to catch up, on by default.
+    void setFrameDropping(bool on);
+    Stats stats() const;
 private:
     ST7735S& screen;
+    PartialUpdater partialUpdater;
 
     uniframe::Orientation orientation;
 
@@ -46,22 +92,82 @@ private:
 
     us_t durationUs = 0;
 
+    // A frame later than this is dropped instead of converted / sent.
+    const us_t lateDropUs = 40000;
+    // Frames shown after their time by more than this count as late.
+    const us_t lateToleranceUs = 5000;
+    // Never drop more frames in a row, the picture keeps moving when nothing is in time.
+    const uint64_t maxDropsInRow = 8;
+    // Consecutive late frames before the decoder skips more, on time frames before it skips less.
+    const int lateRunEscalate = 8;
+    const int onTimeRunRelax = 100;
+
+    DecoderOptions decoderOptions;
+
     // Smart pointer for allocating and memory management.
     struct AVFrameDeleter {
         void operator()(AVFrame* f) const { av_frame_free(&f); }
     };
     using AVFramePtr = std::unique_ptr<AVFrame, AVFrameDeleter>;
 
+    // Fixed set of display-sized destination frames. The pixels come from an AVBufferPool
+    // and are attached to "buf[0]", dropping a frame hands both back: steady playback allocates nothing.
+    class FramePool {
+    public:
+        struct Releaser {
+            Releaser() : pool(nullptr) {}
+            Releaser(FramePool* pool) : pool(pool) {}
+            FramePool* pool;
+            void operator()(AVFrame* f) const { pool->release(f); }
+        };
+        using Ptr = std::unique_ptr<AVFrame, Releaser>;
+
+        FramePool() = default;
+        ~FramePool();
+        FramePool(const FramePool&) = delete;
+        FramePool& operator=(const FramePool&) = delete;
+        // Every frame must be back before calling it again.
+        bool init(size_t count, AVPixelFormat format, int width, int height);
+        // Waits for a frame to come back when all are in use, nullptr once "running" is false.
+        Ptr acquire(const std::atomic<bool>& running);
+        // Wake acquire() up to check "running".
+        void wakeAll();
+    private:
+        void release(AVFrame* frame);
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::vector<AVFrame*> frames;
+        std::vector<AVFrame*> framesFree;
+        AVBufferPool* buffers = nullptr;
+        AVPixelFormat format = AV_PIX_FMT_NONE;
+        int width = 0;
+        int height = 0;
+    };
+
     struct AVPacketDeleter {
         void operator()(AVPacket* p) const { av_packet_free(&p); }
     };
     using AVPacketPtr = std::unique_ptr<AVPacket, AVPacketDeleter>;
 
+    // Ring items carry the seek generation they belong to, stale ones are dropped wherever they are met.
+    struct PacketItem {
+        AVPacketPtr packet;
+        uint32_t generation = 0;
+    };
+    struct FrameItem {
+        FramePool::Ptr frame;
+        uint32_t generation = 0;
+    };
+
     // Time sync management
     TimeSync timeSync;
 
-    std::queue<AVPacketPtr> queuePacketVideo;
-    std::queue<AVFramePtr> queueRawVideo;
+    // Outlives the queues holding its frames.
+    FramePool framePool;
+
+    // demux -> decode -> display, one producer and one consumer each.
+    SpscRing<PacketItem> queuePacketVideo{maxQueueSizePacketVideo};
+    SpscRing<FrameItem> queueRawVideo{maxQueueSizeRawVideo};
 
     std::thread threadDemux;
     std::thread threadDecodeVideo;
@@ -69,33 +175,45 @@ private:
     std::thread threadDisplay;
     std::thread threadControl;
 
-    std::mutex mtxPacketVideo;
     // std::mutex mtxPacketAudio;
-    std::mutex mtxRawVideo;
     // std::mutex mtxRawAudio;
-
-    std::condition_variable cvPacketVideo;
     // std::condition_variable cvPacketAudio;
-    std::condition_variable cvRawVideo;
     // std::condition_variable cvRawAudio;
 
 
     // // deprecated use smart pointer instead.
     // std::queue<AVPacket*> queuePacketVideo;
     // std::queue<AVFrame*> queueRawVideo;
-    
-    // // deprecated use AVFrame instead
-    // std::queue<std::unique_ptr<uniframe::ImageRGB565>> queueRawVideo;
-    // uniframe::FramePool framePool{maxQueueSizeRawVideo};
 
     std::atomic<bool> running;
-    std::atomic<bool> flushing{false};
+    // Bumped by the demuxer on each seek; packets and frames of an older one are stale.
+    std::atomic<uint32_t> seekGeneration{0};
+    // Generation of the frames on the panel, the decoder judges lateness only on those.
+    std::atomic<uint32_t> displayGeneration{0};
+    std::atomic<us_t> seekRequestedUs{0};
     std::atomic<bool> seekRequest{false};
     std::atomic<us_t> seekTargetUs{0};
     std::atomic<double> speedFactor{1.0};
     std::atomic<bool> paused{false};
     std::atomic<bool> resetTimeRequest{false};
     std::atomic<us_t> currentPtsUs{0};
+    std::atomic<bool> partialUpdate{false};
+    std::atomic<bool> frameDropping{true};
+
+    // Decoder-side skipping, raised by the display thread and applied by the decode thread:
+    // 0 none, 1 non-reference frames, 2 also the loop filter, 3 everything but key frames.
+    std::atomic<int> skipLevel{0};
+    std::atomic<uint64_t> framesShown{0};
+    std::atomic<uint64_t> framesLate{0};
+    std::atomic<uint64_t> framesDroppedDecode{0};
+    std::atomic<uint64_t> framesDroppedDisplay{0};
+    // Dropped since the last frame shown, both threads
+    std::atomic<uint64_t> dropsInRow{0};
+    std::atomic<uint64_t> framesDecoded{0};
+    std::atomic<uint64_t> decodeUs{0};
+    std::atomic<uint64_t> seeksShown{0};
+    std::atomic<us_t> seekLatencyUs{0};
+    std::atomic<us_t> maxSeekLatencyUs{0};
 
     AVFormatContext* formatCtx = nullptr;
 
@@ -116,4 +234,5 @@ private:
     void loopDecodeVideo();
     void loopDisplayVideo();
     void loopControl();
+    void applySkipLevel(int level);
 };
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "transport.hpp"
+
+// In-memory ST7735S: decodes the command stream into a simulated GRAM and
+// counts the bus traffic, so the drawing paths can run without the board.
+class VirtualPanel : public Transport {
+public:
+    struct Stats {
+        uint64_t bytesCmd = 0;
+        uint64_t bytesData = 0;
+        // One per transfer() call, i.e. one ioctl on spidev.
+        uint64_t transactions = 0;
+        uint64_t segments = 0;
+        uint64_t toggleDC = 0;
+        // RAMWR commands
+        uint64_t writes = 0;
+        // Time the bytes take on the wire at "sclkHz".
+        double busTimeUs = 0;
+    };
+
+    // "panelWidth" / "panelHeight" is the resolution selected by GM[2:0] on the visible glass.
+    // "bufsiz" mirrors the spidev limit of one message.
+    explicit VirtualPanel(uint32_t sclkHz = 32000000,
+        int panelWidth = 128, int panelHeight = 160,
+        int gramWidth = 132, int gramHeight = 162,
+        size_t bufsiz = 4096);
+
+    void setRST(bool level) override;
+    void setDC(bool level) override;
+    void transfer(const spi_ioc_transfer* segments, size_t count) override;
+    size_t maxTransferSize() const override { return bufsiz; }
+
+    const Stats& stats() const { return counters; }
+    void resetStats();
+    void printStats(std::ostream& os) const;
+    // RGB888 of the pixel at the physical position
+    uint32_t pixel(int x, int y) const;
+    // Visible area as a binary PPM (P6)
+    bool dumpPPM(const std::string& path) const;
+
+private:
+    uint32_t sclkHz;
+    int panelWidth;
+    int panelHeight;
+    int gramWidth;
+    int gramHeight;
+    size_t bufsiz;
+    std::vector<uint8_t> gram;
+    Stats counters;
+
+    bool levelDC = false;
+    bool levelRST = true;
+    uint8_t command = 0x00;
+    size_t paramIndex = 0;
+    uint8_t params[4] = {};
+    uint16_t xS = 0, xE = 0, yS = 0, yE = 0;
+    uint16_t col = 0, row = 0;
+    uint8_t MADCTL = 0x00;
+    uint8_t COLMOD = 0x06;
+    // Bytes of a pixel (or pixel pair in 12 bits mode) still being received
+    uint8_t pixelBytes[3] = {};
+    size_t pixelBytesCount = 0;
+
+    void resetState();
+    void onCommand(uint8_t cmd);
+    void onData(uint8_t byte);
+    void onPixelByte(uint8_t byte);
+    void storePixel(uint8_t r, uint8_t g, uint8_t b);
+};
@@ -0,0 +1,172 @@
+#include "animation_player.hpp"
+#include "image_handler.hpp"
+#include "partial_updater.hpp"
+#include "pixel_kernels.hpp"
+
+#include <cstring>
+#include <iostream>
+
+AnimationPlayer::AnimationPlayer(ST7735S& screen)
+    : screen(screen)
+{
+}
+
+bool AnimationPlayer::load(const std::string& path, uniframe::Orientation orientation)
+{
+    imghandler::AnimationRGB24 animation;
+    if (!imghandler::decodeGifToRGB24(path, animation) || animation.delays.empty()) return false;
+    const size_t count = animation.delays.size();
+
+    layout.orientation = orientation;
+    layout.format = screen.pixelFormat();
+    layout.window = screen.fitWindow(animation.width, animation.height, orientation, layout.area);
+    const int width = layout.window.xE - layout.window.xS + 1;
+    const int height = layout.window.yE - layout.window.yS + 1;
+    const bool rgb444 = layout.format == uniframe::PixelFormat::RGB444;
+    const size_t srcFrameBytes = static_cast<size_t>(animation.width) * animation.height * 3;
+
+    std::vector<uint8_t> rgb24(static_cast<size_t>(width) * height * 3);
+    std::vector<uint8_t> rgb565(static_cast<size_t>(width) * height * 2);
+    // Changes are looked for at the panel precision, RGB565, whatever the bus format.
+    PartialUpdater tracker(screen, 2);
+    full.clear();
+    frames.clear();
+    payload.clear();
+
+    // Pixels of "rect" in the bus format, appended to "out".
+    auto encode = [&](const PartialUpdater::Rect& rect, std::vector<uint8_t>& out) {
+        size_t offset = out.size();
+        size_t len = uniframe::frameBytes(layout.format, static_cast<size_t>(rect.width) * rect.height);
+        out.resize(offset + len);
+        if (rgb444) {
+            imghandler::packRGB24ToRGB444(rgb24.data() + (static_cast<size_t>(rect.y) * width + rect.x) * 3,
+                                          static_cast<size_t>(width) * 3, rect.width, rect.height, out.data() + offset);
+            return len;
+        }
+        for (int y = 0; y < rect.height; ++y) {
+            std::memcpy(out.data() + offset + static_cast<size_t>(y) * rect.width * 2,
+                        rgb565.data() + (static_cast<size_t>(rect.y + y) * width + rect.x) * 2,
+                        static_cast<size_t>(rect.width) * 2);
+        }
+        return len;
+    };
+
+    // One extra pass over frame 0 gives the updates from the last frame back to the first.
+    for (size_t i = 0; i <= count; ++i) {
+        size_t index = i % count;
+        imghandler::RowScaler scaler(animation.width, animation.height, width, height,
+            [&](int y, const uint8_t* row) {
+                std::memcpy(rgb24.data() + static_cast<size_t>(y) * width * 3, row, static_cast<size_t>(width) * 3);
+            });
+        const uint8_t* src = animation.data.data() + index * srcFrameBytes;
+        for (int y = 0; y < animation.height; ++y) {
+            scaler.pushRow(src + static_cast<size_t>(y) * animation.width * 3);
+        }
+        pixkernel::rgb888ToRGB565BE(rgb24.data(), rgb565.data(), static_cast<size_t>(width) * height);
+        const std::vector<PartialUpdater::Rect>& rects = tracker.track(rgb565.data(), static_cast<size_t>(width) * 2, width, height);
+
+        std::chrono::milliseconds delay(animation.delays[index]);
+        if (delay <= std::chrono::milliseconds(10)) delay = defaultDelay;
+        if (i == 0) {
+            encode(rects.front(), full);
+            frames.push_back({{}, delay});
+            continue;
+        }
+        if (i < count) frames.push_back({{}, delay});
+        Frame& frame = frames[index];
+        for (const auto& rect : rects) {
+            size_t offset = payload.size();
+            size_t len = encode(rect, payload);
+            ST7735S::Window window = {
+                static_cast<uint8_t>(layout.window.xS + rect.x),
+                static_cast<uint8_t>(layout.window.xS + rect.x + rect.width - 1),
+                static_cast<uint8_t>(layout.window.yS + rect.y),
+                static_cast<uint8_t>(layout.window.yS + rect.y + rect.height - 1)};
+            frame.updates.push_back({window, offset, len});
+        }
+    }
+    payload.shrink_to_fit();
+    std::cout << "Animation: " << count << " frames, " << sizeBytes() << " bytes prepared" << std::endl;
+    return true;
+}
+
+void AnimationPlayer::play(int loops)
+{
+    if (frames.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        running = true;
+    }
+    screen.clear();
+    screen.showImage(layout, full.data(), full.size());
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        ++counters.shown;
+        counters.bytesSent += full.size();
+    }
+
+    Clock::time_point showAt = Clock::now();
+    size_t index = 0;
+    int loop = 0;
+    while (true) {
+        showAt += frames[index].delay;
+        if (++index == frames.size()) {
+            index = 0;
+            // The last frame stays for its delay too.
+            if (loops > 0 && ++loop == loops) {
+                waitUntil(showAt);
+                break;
+            }
+        }
+        if (!waitUntil(showAt)) break;
+        Clock::time_point now = Clock::now();
+        showFrame(frames[index]);
+        // A late frame gets its full delay, the schedule restarts from it.
+        if (now - showAt > std::chrono::milliseconds(1)) {
+            std::lock_guard<std::mutex> lock(mtx);
+            ++counters.late;
+            showAt = now;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    running = false;
+}
+
+void AnimationPlayer::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        running = false;
+    }
+    cv.notify_all();
+}
+
+AnimationPlayer::Stats AnimationPlayer::stats()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return counters;
+}
+
+bool AnimationPlayer::waitUntil(Clock::time_point when)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    return !cv.wait_until(lock, when, [&]() { return !running; });
+}
+
+void AnimationPlayer::showFrame(const Frame& frame)
+{
+    uint64_t bytes = 0;
+    for (const auto& update : frame.updates) {
+        screen.rangeSet(update.window.xS, update.window.xE, update.window.yS, update.window.yE);
+        screen.writeFrame(payload.data() + update.offset, update.len);
+        bytes += update.len;
+    }
+    // Leave the full window behind for the other writers.
+    if (!frame.updates.empty()) {
+        screen.rangeSet(layout.window.xS, layout.window.xE, layout.window.yS, layout.window.yE);
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    ++counters.shown;
+    counters.bytesSent += bytes;
+}
@@ -0,0 +1,257 @@
+#include "image_cache.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+
+constexpr char entryMagic[8] = {'S', 'T', '7', '7', '3', '5', 'I', 'C'};
+constexpr char indexMagic[8] = {'S', 'T', '7', '7', '3', '5', 'I', 'X'};
+constexpr uint32_t formatVersion = 1;
+// Pixels start on a cache line
+constexpr uint64_t payloadAlign = 64;
+
+}
+
+ImageCache::Mapping::~Mapping()
+{
+    if (base) munmap(base, mapped);
+}
+
+ImageCache::ImageCache(const std::string& dir, uint64_t maxBytes)
+    : dir(dir), maxBytes(maxBytes)
+{
+    if (::mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::runtime_error("Failed to create cache directory");
+    }
+    loadIndex();
+}
+
+ImageCache::~ImageCache()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if (dirty) saveIndex();
+}
+
+std::string ImageCache::key(const std::string& path, int screenWidth, int screenHeight,
+    uniframe::Orientation orientation, uniframe::PixelFormat format)
+{
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) return "";
+    std::ostringstream key;
+    key << path << '\n' << st.st_size << '\n'
+        << st.st_mtim.tv_sec << '.' << st.st_mtim.tv_nsec << '\n'
+        << screenWidth << 'x' << screenHeight << '\n'
+        << static_cast<int>(orientation) << '\n' << static_cast<int>(format);
+    return key.str();
+}
+
+uint64_t ImageCache::hashOf(const std::string& key)
+{
+    // FNV-1a, the full key is kept in the entry to rule out collisions.
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+std::string ImageCache::entryPath(uint64_t hash) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%016llx.img", static_cast<unsigned long long>(hash));
+    return dir + name;
+}
+
+std::unique_ptr<ImageCache::Mapping> ImageCache::find(const std::string& key)
+{
+    if (key.empty()) return nullptr;
+    std::lock_guard<std::mutex> lock(mtx);
+    uint64_t hash = hashOf(key);
+    auto it = std::find_if(records.begin(), records.end(), [&](const Record& r) { return r.hash == hash; });
+    if (it == records.end()) return nullptr;
+    size_t index = it - records.begin();
+
+    int fd = ::open(entryPath(hash).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        removeRecord(index);
+        return nullptr;
+    }
+    struct stat st;
+    void* base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(EntryHeader)) {
+        base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        removeRecord(index);
+        return nullptr;
+    }
+
+    size_t size = st.st_size;
+    const auto* header = static_cast<const EntryHeader*>(base);
+    const char* storedKey = static_cast<const char*>(base) + sizeof(EntryHeader);
+    bool valid = std::memcmp(header->magic, entryMagic, sizeof(entryMagic)) == 0 &&
+                 header->version == formatVersion &&
+                 header->keyLength == key.size() &&
+                 sizeof(EntryHeader) + header->keyLength <= header->payloadOffset &&
+                 header->payloadOffset <= size &&
+                 header->payloadBytes <= size - header->payloadOffset &&
+                 std::memcmp(storedKey, key.data(), key.size()) == 0;
+    if (!valid) {
+        munmap(base, size);
+        ::unlink(entryPath(hash).c_str());
+        removeRecord(index);
+        return nullptr;
+    }
+    madvise(base, size, MADV_WILLNEED);
+    records[index].lastUse = ++clock;
+    dirty = true;
+
+    std::unique_ptr<Mapping> mapping(new Mapping());
+    mapping->base = base;
+    mapping->mapped = size;
+    mapping->offset = header->payloadOffset;
+    mapping->length = header->payloadBytes;
+    ST7735S::ImageLayout& layout = mapping->imageLayout;
+    layout.orientation = static_cast<uniframe::Orientation>(header->orientation);
+    layout.format = static_cast<uniframe::PixelFormat>(header->format);
+    layout.window = {header->xS, header->xE, header->yS, header->yE};
+    layout.area = {header->displayWidth, header->displayHeight};
+    return mapping;
+}
+
+bool ImageCache::store(const std::string& key, const ST7735S::ImageLayout& layout, const uint8_t* data, size_t len)
+{
+    if (key.empty()) return false;
+    EntryHeader header = {};
+    std::memcpy(header.magic, entryMagic, sizeof(entryMagic));
+    header.version = formatVersion;
+    header.keyLength = key.size();
+    header.payloadOffset = (sizeof(EntryHeader) + key.size() + payloadAlign - 1) / payloadAlign * payloadAlign;
+    header.payloadBytes = len;
+    header.displayWidth = layout.area.displayWidth;
+    header.displayHeight = layout.area.displayHeight;
+    header.xS = layout.window.xS;
+    header.xE = layout.window.xE;
+    header.yS = layout.window.yS;
+    header.yE = layout.window.yE;
+    header.orientation = static_cast<uint8_t>(layout.orientation);
+    header.format = static_cast<uint8_t>(layout.format);
+    uint64_t fileBytes = header.payloadOffset + len;
+    if (fileBytes > maxBytes) return false;
+
+    std::lock_guard<std::mutex> lock(mtx);
+    uint64_t hash = hashOf(key);
+    // Written aside and renamed, a reader never maps a half written entry.
+    std::string path = entryPath(hash);
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        const char zeros[payloadAlign] = {};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(key.data(), key.size());
+        file.write(zeros, header.payloadOffset - sizeof(header) - key.size());
+        file.write(reinterpret_cast<const char*>(data), len);
+        if (!file) {
+            ::unlink(tmp.c_str());
+            return false;
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        ::unlink(tmp.c_str());
+        return false;
+    }
+
+    auto it = std::find_if(records.begin(), records.end(), [&](const Record& r) { return r.hash == hash; });
+    if (it == records.end()) {
+        records.push_back({hash, 0, 0});
+        it = records.end() - 1;
+    }
+    totalBytes = totalBytes - it->bytes + fileBytes;
+    it->bytes = fileBytes;
+    it->lastUse = ++clock;
+    evict(hash);
+    saveIndex();
+    return true;
+}
+
+uint64_t ImageCache::sizeBytes()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return totalBytes;
+}
+
+void ImageCache::removeRecord(size_t i)
+{
+    totalBytes -= records[i].bytes;
+    records.erase(records.begin() + i);
+    dirty = true;
+}
+
+void ImageCache::evict(uint64_t keep)
+{
+    // Least recently used first, "keep" is the entry just stored.
+    while (totalBytes > maxBytes) {
+        auto victim = records.end();
+        for (auto it = records.begin(); it != records.end(); ++it) {
+            if (it->hash == keep) continue;
+            if (victim == records.end() || it->lastUse < victim->lastUse) victim = it;
+        }
+        if (victim == records.end()) break;
+        ::unlink(entryPath(victim->hash).c_str());
+        removeRecord(victim - records.begin());
+    }
+}
+
+void ImageCache::loadIndex()
+{
+    std::ifstream file(dir + "/index", std::ios::binary);
+    if (!file) return;
+    IndexHeader header = {};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || std::memcmp(header.magic, indexMagic, sizeof(indexMagic)) != 0 || header.version != formatVersion) return;
+    clock = header.clock;
+    for (uint32_t i = 0; i < header.count; ++i) {
+        Record record;
+        file.read(reinterpret_cast<char*>(&record), sizeof(record));
+        if (!file) break;
+        // Entries deleted behind our back are forgotten.
+        struct stat st;
+        if (::stat(entryPath(record.hash).c_str(), &st) != 0) continue;
+        records.push_back(record);
+        totalBytes += record.bytes;
+    }
+    evict(0);
+}
+
+void ImageCache::saveIndex()
+{
+    std::string path = dir + "/index";
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        IndexHeader header = {};
+        std::memcpy(header.magic, indexMagic, sizeof(indexMagic));
+        header.version = formatVersion;
+        header.count = records.size();
+        header.clock = clock;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(Record));
+        if (!file) {
+            ::unlink(tmp.c_str());
+            return;
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) == 0) dirty = false;
+}
@@ -1,10 +1,22 @@
 #include "image_handler.hpp"
+#include "pixel_kernels.hpp"
 #include <fstream>
 #include <cstring>
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
+#include <csetjmp>
+#include <cstdio>
 #include <turbojpeg.h>
+#include <jpeglib.h>
+#include <png.h>
 #include "stb_image.h"
 #include <libyuv.h>
 
@@ -17,43 +29,204 @@ ImageType formatProbe(const std::string& path)
         throw std::runtime_error("Failed to open image file");
     }
 
-    uint8_t header[8] = {};
+    uint8_t header[12] = {};
     file.read(reinterpret_cast<char*>(header), sizeof(header));
 
     if (std::memcmp(header, "\xFF\xD8", 2) == 0) {
         return ImageType::JPG;
     }
-    // if (png_sig_cmp(header, 0, 8) == 0) {
-    //     return ImageType::PNG;
-    // }
-    throw std::runtime_error("Unsupported image format");
+    if (std::memcmp(header, "\x89PNG\r\n\x1A\n", 8) == 0) {
+        return ImageType::PNG;
+    }
+    if (std::memcmp(header, "GIF87a", 6) == 0 || std::memcmp(header, "GIF89a", 6) == 0) {
+        return ImageType::GIF;
+    }
+    if (std::memcmp(header, "RIFF", 4) == 0 && std::memcmp(header + 8, "WEBP", 4) == 0) {
+        return ImageType::WEBP;
+    }
+    if (std::memcmp(header, "BM", 2) == 0) {
+        return ImageType::BMP;
+    }
+    return ImageType::Unknown;
 }
 
-bool decodeJpegToRGB24(const std::string& filename, ImageRGB24& image)
+MappedFile::~MappedFile()
 {
-    std::ifstream file(filename, std::ios::binary);
-    if (!file) return false;
-    std::vector<uint8_t> jpegBuf((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    close();
+}
 
-    tjhandle handle = tjInitDecompress();
-    if (!handle) throw std::runtime_error("Decompressor init failed");
-    if (tjDecompressHeader(handle, jpegBuf.data(), jpegBuf.size(), &image.width, &image.height)) {
-        tjDestroy(handle);
-        return false;
-    }
-    image.data.resize(image.width * image.height * 3);
-    if (tjDecompress2(handle, jpegBuf.data(), jpegBuf.size(), image.data.data(), image.width, 0, image.height, TJPF_RGB, TJFLAG_FASTDCT)) {
-        tjDestroy(handle);
+bool MappedFile::open(const std::string& path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
         return false;
     }
-    tjDestroy(handle);
+    void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) return false;
+    madvise(mapped, st.st_size, MADV_SEQUENTIAL);
+    base = static_cast<const uint8_t*>(mapped);
+    length = st.st_size;
     return true;
 }
 
+void MappedFile::close()
+{
+    if (base) munmap(const_cast<uint8_t*>(base), length);
+    base = nullptr;
+    length = 0;
+}
+
+namespace {
+
+// One decompressor per thread, kept until the thread exits.
+tjhandle threadDecompressor()
+{
+    struct Handle {
+        tjhandle handle = tjInitDecompress();
+        ~Handle() { if (handle) tjDestroy(handle); }
+    };
+    thread_local Handle decompressor;
+    if (!decompressor.handle) throw std::runtime_error("Decompressor init failed");
+    return decompressor.handle;
+}
+
+}
+
+bool decodeJpegToRGB24(const uint8_t* jpeg, size_t len, ImageRGB24& image, int boxWidth, int boxHeight)
+{
+    tjhandle handle = threadDecompressor();
+    int width, height;
+    if (tjDecompressHeader(handle, const_cast<uint8_t*>(jpeg), len, &width, &height)) return false;
+    // Smallest DCT scaling (1/2 ... 1/8) still covering the image fitted in the box,
+    // the box filter does the rest from there.
+    image.width = width;
+    image.height = height;
+    int factorCount = 0;
+    tjscalingfactor* factors = tjGetScalingFactors(&factorCount);
+    if (boxWidth > 0 && boxHeight > 0 && factors) {
+        double fit = std::min(static_cast<double>(boxWidth) / width, static_cast<double>(boxHeight) / height);
+        long needWidth = std::lround(width * fit);
+        long needHeight = std::lround(height * fit);
+        for (int i = 0; i < factorCount; ++i) {
+            if (factors[i].num > factors[i].denom) continue;
+            int scaledWidth = TJSCALED(width, factors[i]);
+            int scaledHeight = TJSCALED(height, factors[i]);
+            if (scaledWidth >= needWidth && scaledHeight >= needHeight &&
+                static_cast<int64_t>(scaledWidth) * scaledHeight < static_cast<int64_t>(image.width) * image.height) {
+                image.width = scaledWidth;
+                image.height = scaledHeight;
+            }
+        }
+    }
+    // Keeps its capacity, a reused "image" decodes without allocating.
+    image.data.resize(static_cast<size_t>(image.width) * image.height * 3);
+    // tjDecompress2 picks the scaling factor matching the requested size.
+    return tjDecompress2(handle, jpeg, len, image.data.data(), image.width, 0, image.height, TJPF_RGB, TJFLAG_FASTDCT) == 0;
+}
+
+namespace {
+
+uint16_t readU16(const uint8_t* p, bool bigEndian)
+{
+    return bigEndian ? (p[0] << 8) | p[1] : (p[1] << 8) | p[0];
+}
+
+uint32_t readU32(const uint8_t* p, bool bigEndian)
+{
+    return bigEndian ? (static_cast<uint32_t>(readU16(p, true)) << 16) | readU16(p + 2, true)
+                     : (static_cast<uint32_t>(readU16(p + 2, false)) << 16) | readU16(p, false);
+}
+
+}
+
+bool extractExifThumbnail(const uint8_t* jpeg, size_t len, const uint8_t*& thumb, size_t& thumbLen)
+{
+    if (len < 4 || jpeg[0] != 0xFF || jpeg[1] != 0xD8) return false;
+    // Walk the markers up to the APP1 "Exif" segment, it comes before the image data.
+    size_t pos = 2;
+    while (pos + 4 <= len && jpeg[pos] == 0xFF) {
+        uint8_t marker = jpeg[pos + 1];
+        size_t segLen = readU16(jpeg + pos + 2, true);
+        if (marker == 0xDA || segLen < 2 || pos + 2 + segLen > len) return false;
+        const uint8_t* seg = jpeg + pos + 4;
+        size_t payload = segLen - 2;
+        pos += 2 + segLen;
+        if (marker != 0xE1 || payload < 14 || std::memcmp(seg, "Exif\0\0", 6) != 0) continue;
+
+        // TIFF header, IFD0, then IFD1 describes the thumbnail.
+        const uint8_t* tiff = seg + 6;
+        size_t tiffLen = payload - 6;
+        bool bigEndian = tiff[0] == 'M';
+        if (std::memcmp(tiff, bigEndian ? "MM" : "II", 2) != 0) return false;
+        // Offsets come from the file, "off + n" could wrap: compare without adding.
+        auto fits = [tiffLen](size_t off, size_t n) { return off <= tiffLen && tiffLen - off >= n; };
+        size_t ifd = readU32(tiff + 4, bigEndian);
+        if (!fits(ifd, 2)) return false;
+        uint16_t entries = readU16(tiff + ifd, bigEndian);
+        size_t next = ifd + 2 + static_cast<size_t>(entries) * 12;
+        if (!fits(next, 4)) return false;
+        ifd = readU32(tiff + next, bigEndian);
+        if (ifd == 0 || !fits(ifd, 2)) return false;
+        entries = readU16(tiff + ifd, bigEndian);
+
+        uint32_t offset = 0, length = 0;
+        for (uint16_t i = 0; i < entries; ++i) {
+            size_t entry = ifd + 2 + static_cast<size_t>(i) * 12;
+            if (!fits(entry, 12)) return false;
+            uint16_t tag = readU16(tiff + entry, bigEndian);
+            uint16_t type = readU16(tiff + entry + 2, bigEndian);
+            // SHORT or LONG value held in the entry itself
+            uint32_t value = type == 3 ? readU16(tiff + entry + 8, bigEndian) : readU32(tiff + entry + 8, bigEndian);
+            if (tag == 0x0201) offset = value;      // JPEGInterchangeFormat
+            if (tag == 0x0202) length = value;      // JPEGInterchangeFormatLength
+        }
+        if (offset == 0 || length < 4 || offset > tiffLen || length > tiffLen - offset) return false;
+        if (tiff[offset] != 0xFF || tiff[offset + 1] != 0xD8) return false;
+        thumb = tiff + offset;
+        thumbLen = length;
+        return true;
+    }
+    return false;
+}
+
+bool decodeJpegToRGB24(const std::string& filename, ImageRGB24& image, int boxWidth, int boxHeight)
+{
+    MappedFile file;
+    if (!file.open(filename)) return false;
+    return decodeJpegToRGB24(file.data(), file.size(), image, boxWidth, boxHeight);
+}
+
+bool decodeExifThumbnailToRGB24(const std::string& filename, ImageRGB24& image, int boxWidth, int boxHeight)
+{
+    // Only the pages of the EXIF block are read from the mapping.
+    MappedFile file;
+    if (!file.open(filename)) return false;
+    const uint8_t* thumb = nullptr;
+    size_t thumbLen = 0;
+    if (!extractExifThumbnail(file.data(), file.size(), thumb, thumbLen)) return false;
+    int width, height;
+    if (tjDecompressHeader(threadDecompressor(), const_cast<uint8_t*>(thumb), thumbLen, &width, &height)) return false;
+    // Too small once fitted in the box: the full image is needed.
+    double fit = std::min(static_cast<double>(boxWidth) / width, static_cast<double>(boxHeight) / height);
+    if (fit > 1.0) return false;
+    return decodeJpegToRGB24(thumb, thumbLen, image);
+}
+
 bool decodeImageToRGB24(const std::string& filename, ImageRGB24& image)
 {
+    MappedFile file;
+    if (!file.open(filename) || file.size() > static_cast<size_t>(INT32_MAX)) {
+        std::cerr << "Failed to load image: " << filename << std::endl;
+        return false;
+    }
+    // stb allocates the pixels itself, they are copied once into the (reused) "image".
     int width, height, channels;
-    unsigned char* pixels = stbi_load(filename.c_str(), &width, &height, &channels, 3);
+    unsigned char* pixels = stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &width, &height, &channels, 3);
     if (!pixels) {
         std::cerr << "Failed to load image: " << filename << std::endl;
         return false;
@@ -61,7 +234,7 @@ bool decodeImageToRGB24(const std::string& filename, ImageRGB24& image)
 
     image.width = width;
     image.height = height;
-    image.data.assign(pixels, pixels + width * height * 3);
+    image.data.assign(pixels, pixels + static_cast<size_t>(width) * height * 3);
     stbi_image_free(pixels);
 
     // std::vector<uint8_t> sub(image.data.begin(), image.data.end());
@@ -73,6 +246,32 @@ bool decodeImageToRGB24(const std::string& filename, ImageRGB24& image)
     return true;
 }
 
+bool decodeGifToRGB24(const std::string& filename, AnimationRGB24& animation)
+{
+    MappedFile file;
+    if (!file.open(filename) || file.size() > static_cast<size_t>(INT32_MAX)) {
+        std::cerr << "Failed to load animation: " << filename << std::endl;
+        return false;
+    }
+    int width, height, frames, channels;
+    int* delays = nullptr;
+    unsigned char* pixels = stbi_load_gif_from_memory(file.data(), static_cast<int>(file.size()), &delays,
+                                                      &width, &height, &frames, &channels, 3);
+    if (!pixels) {
+        std::cerr << "Failed to load animation: " << filename << std::endl;
+        return false;
+    }
+
+    animation.width = width;
+    animation.height = height;
+    animation.data.assign(pixels, pixels + static_cast<size_t>(width) * height * 3 * frames);
+    animation.delays.assign(frames, 0);
+    if (delays) std::copy(delays, delays + frames, animation.delays.begin());
+    stbi_image_free(pixels);
+    stbi_image_free(delays);
+    return true;
+}
+
 bool scaleImage(const ImageRGB24& src, ImageRGB24& dst, int targetWidth, int targetHeight)
 {
     dst.width = targetWidth;
@@ -104,13 +303,7 @@ bool convertToRGB565(const ImageRGB24& src, ImageRGB565& dst)
     dst.height = src.height;
     dst.data.resize(src.width * src.height * 2);
 
-    std::vector<uint8_t> ARGB(src.width * src.height * 4);
-
-    if (libyuv::RAWToARGB(src.data.data(), src.width * 3, ARGB.data(), src.width * 4, src.width, src.height) != 0) return false;
-    if (libyuv::ARGBToRGB565(ARGB.data(), src.width * 4, dst.data.data(), dst.width * 2, dst.width, dst.height) != 0) return false;
-    for (size_t i = 0; i < dst.data.size(); i += 2) {
-        std::swap(dst.data[i], dst.data[i + 1]);
-    }
+    pixkernel::rgb888ToRGB565BE(src.data.data(), dst.data.data(), static_cast<size_t>(src.width) * src.height);
     
     // std::vector<uint8_t> sub(dst.data.begin(), dst.data.end());
     // for (uint8_t b : sub) {
@@ -121,4 +314,327 @@ bool convertToRGB565(const ImageRGB24& src, ImageRGB565& dst)
     return true;
 }
 
+bool convertToRGB444(const ImageRGB24& src, ImageRGB444& dst)
+{
+    dst.width = src.width;
+    dst.height = src.height;
+    dst.data.resize((static_cast<size_t>(src.width) * src.height + 1) / 2 * 3);
+    packRGB24ToRGB444(src.data.data(), src.width * 3, src.width, src.height, dst.data.data());
+    return true;
+}
+
+void packRGB24ToRGB444(const uint8_t* src, size_t srcStride, int width, int height, uint8_t* dst)
+{
+    // Pixel left over from an odd row, paired with the first one of the next row
+    bool pending = false;
+    uint8_t r = 0, g = 0, b = 0;
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* p = src + y * srcStride;
+        int x = 0;
+        if (pending && width > 0) {
+            dst[0] = (r & 0xF0) | (g >> 4);
+            dst[1] = (b & 0xF0) | (p[0] >> 4);
+            dst[2] = (p[1] & 0xF0) | (p[2] >> 4);
+            dst += 3;
+            p += 3;
+            x = 1;
+            pending = false;
+        }
+        for (; x + 1 < width; x += 2, p += 6, dst += 3) {
+            dst[0] = (p[0] & 0xF0) | (p[1] >> 4);
+            dst[1] = (p[2] & 0xF0) | (p[3] >> 4);
+            dst[2] = (p[4] & 0xF0) | (p[5] >> 4);
+        }
+        if (x < width) {
+            pending = true;
+            r = p[0];
+            g = p[1];
+            b = p[2];
+        }
+    }
+    // Odd pixel count: the panel only stores complete pairs. The padding pixel
+    // wraps around to the start of the window, so it repeats the first pixel.
+    if (pending) {
+        dst[0] = (r & 0xF0) | (g >> 4);
+        dst[1] = (b & 0xF0) | (src[0] >> 4);
+        dst[2] = (src[1] & 0xF0) | (src[2] >> 4);
+    }
+}
+
+RowScaler::RowScaler(int srcWidth, int srcHeight, int dstWidth, int dstHeight, EmitRow emitRow)
+    : srcHeight(srcHeight), dstWidth(dstWidth), dstHeight(dstHeight), emitRow(std::move(emitRow)),
+      xBegin(dstWidth), xEnd(dstWidth), acc(dstWidth * 3, 0), row(dstWidth * 3)
+{
+    for (int x = 0; x < dstWidth; ++x) {
+        xBegin[x] = static_cast<int>(static_cast<int64_t>(x) * srcWidth / dstWidth);
+        xEnd[x] = std::max(xBegin[x] + 1, static_cast<int>(static_cast<int64_t>(x + 1) * srcWidth / dstWidth));
+    }
+}
+
+int RowScaler::rowBegin(int y) const
+{
+    return static_cast<int>(static_cast<int64_t>(y) * srcHeight / dstHeight);
+}
+
+int RowScaler::rowEnd(int y) const
+{
+    return std::max(rowBegin(y) + 1, static_cast<int>(static_cast<int64_t>(y + 1) * srcHeight / dstHeight));
+}
+
+void RowScaler::pushRow(const uint8_t* rgb24)
+{
+    // When enlarging, one source row feeds several output rows.
+    while (dstY < dstHeight && rowBegin(dstY) <= srcY) {
+        uint32_t* a = acc.data();
+        for (int x = 0; x < dstWidth; ++x, a += 3) {
+            const uint8_t* p = rgb24 + xBegin[x] * 3;
+            for (int sx = xBegin[x]; sx < xEnd[x]; ++sx, p += 3) {
+                a[0] += p[0];
+                a[1] += p[1];
+                a[2] += p[2];
+            }
+        }
+        if (srcY + 1 < rowEnd(dstY)) break;
+
+        uint32_t rows = rowEnd(dstY) - rowBegin(dstY);
+        for (int x = 0; x < dstWidth; ++x) {
+            uint32_t count = rows * (xEnd[x] - xBegin[x]);
+            for (int c = 0; c < 3; ++c) {
+                row[x * 3 + c] = static_cast<uint8_t>((acc[x * 3 + c] + count / 2) / count);
+            }
+        }
+        emitRow(dstY, row.data());
+        std::fill(acc.begin(), acc.end(), 0);
+        ++dstY;
+    }
+    ++srcY;
+}
+
+bool scaleToRGB565(const ImageRGB24& src, ImageRGB565& dst, int targetWidth, int targetHeight)
+{
+    if (targetWidth <= 0 || targetHeight <= 0 || src.width <= 0 || src.height <= 0) return false;
+    dst.width = targetWidth;
+    dst.height = targetHeight;
+    dst.data.resize(static_cast<size_t>(targetWidth) * targetHeight * 2);
+
+    // Big-endian RGB565, the byte order the panel expects.
+    RowScaler scaler(src.width, src.height, targetWidth, targetHeight, [&](int y, const uint8_t* rgb) {
+        pixkernel::rgb888ToRGB565BE(rgb, dst.data.data() + static_cast<size_t>(y) * targetWidth * 2, targetWidth);
+    });
+    for (int y = 0; y < src.height; ++y) {
+        scaler.pushRow(src.data.data() + static_cast<size_t>(y) * src.width * 3);
+    }
+    return true;
+}
+
+bool scaleToRGB444(const ImageRGB24& src, ImageRGB444& dst, int targetWidth, int targetHeight)
+{
+    if (targetWidth <= 0 || targetHeight <= 0 || src.width <= 0 || src.height <= 0) return false;
+    // Pairs can span two rows, so the (small) scaled image is packed at the end.
+    std::vector<uint8_t> scaled(static_cast<size_t>(targetWidth) * targetHeight * 3);
+    RowScaler scaler(src.width, src.height, targetWidth, targetHeight, [&](int y, const uint8_t* rgb) {
+        std::memcpy(scaled.data() + static_cast<size_t>(y) * targetWidth * 3, rgb, targetWidth * 3);
+    });
+    for (int y = 0; y < src.height; ++y) {
+        scaler.pushRow(src.data.data() + static_cast<size_t>(y) * src.width * 3);
+    }
+    dst.width = targetWidth;
+    dst.height = targetHeight;
+    dst.data.resize((static_cast<size_t>(targetWidth) * targetHeight + 1) / 2 * 3);
+    packRGB24ToRGB444(scaled.data(), targetWidth * 3, targetWidth, targetHeight, dst.data.data());
+    return true;
+}
+
+namespace {
+
+// libjpeg reports errors through error_exit, which must not return.
+struct JpegError {
+    jpeg_error_mgr mgr;
+    jmp_buf jump;
+};
+
+void jpegErrorExit(j_common_ptr cinfo)
+{
+    char message[JMSG_LENGTH_MAX];
+    cinfo->err->format_message(cinfo, message);
+    std::cerr << "JPEG decode failed: " << message << std::endl;
+    longjmp(reinterpret_cast<JpegError*>(cinfo->err)->jump, 1);
+}
+
+// What a streaming decode changes while libjpeg may still longjmp. It lives in the
+// caller of the setjmp frame, so its values stay defined and its destructors run
+// normally after a jump.
+struct JpegStream {
+    jpeg_decompress_struct cinfo;
+    JpegError error;
+    std::vector<uint8_t> strip;
+    std::vector<JSAMPROW> stripRowPtrs;
+    std::unique_ptr<RowScaler> scaler;
+};
+
+// The setjmp frame: no local with a destructor or read after a jump, state is in "stream".
+bool readJpegStream(JpegStream& stream, const uint8_t* jpeg, size_t len, const TargetSize& targetSize, const RowScaler::EmitRow& emitRow)
+{
+    // Rows read per jpeg_read_scanlines() round
+    constexpr int stripRows = 16;
+    jpeg_decompress_struct& cinfo = stream.cinfo;
+    cinfo.err = jpeg_std_error(&stream.error.mgr);
+    stream.error.mgr.error_exit = jpegErrorExit;
+    if (setjmp(stream.error.jump)) return false;
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, jpeg, len);
+    if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK) return false;
+    int dstWidth = 0, dstHeight = 0;
+    if (!targetSize(cinfo.image_width, cinfo.image_height, dstWidth, dstHeight) || dstWidth <= 0 || dstHeight <= 0) return false;
+    cinfo.out_color_space = JCS_RGB;
+    cinfo.dct_method = JDCT_IFAST;
+    // Smallest scaling (n/8) still at least as large as the target.
+    cinfo.scale_denom = 8;
+    for (unsigned int num = 1; num <= 8; ++num) {
+        cinfo.scale_num = num;
+        jpeg_calc_output_dimensions(&cinfo);
+        if (static_cast<int>(cinfo.output_width) >= dstWidth && static_cast<int>(cinfo.output_height) >= dstHeight) break;
+    }
+    jpeg_start_decompress(&cinfo);
+
+    size_t rowBytes = static_cast<size_t>(cinfo.output_width) * 3;
+    stream.strip.resize(rowBytes * stripRows);
+    stream.stripRowPtrs.resize(stripRows);
+    for (int i = 0; i < stripRows; ++i) stream.stripRowPtrs[i] = stream.strip.data() + rowBytes * i;
+    stream.scaler = std::make_unique<RowScaler>(cinfo.output_width, cinfo.output_height, dstWidth, dstHeight, emitRow);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JDIMENSION rows = jpeg_read_scanlines(&cinfo, stream.stripRowPtrs.data(), stripRows);
+        for (JDIMENSION i = 0; i < rows; ++i) stream.scaler->pushRow(stream.stripRowPtrs[i]);
+    }
+    jpeg_finish_decompress(&cinfo);
+    return true;
+}
+
+}
+
+bool decodeJpegStreaming(const uint8_t* jpeg, size_t len, const TargetSize& targetSize, const RowScaler::EmitRow& emitRow)
+{
+    // Zeroed: destroying a decompressor that was never created is a no-op.
+    JpegStream stream = {};
+    bool decoded = readJpegStream(stream, jpeg, len, targetSize, emitRow);
+    jpeg_destroy_decompress(&stream.cinfo);
+    return decoded;
+}
+
+bool decodeJpegStreaming(const std::string& filename, const TargetSize& targetSize, const RowScaler::EmitRow& emitRow)
+{
+    MappedFile file;
+    if (!file.open(filename)) return false;
+    return decodeJpegStreaming(file.data(), file.size(), targetSize, emitRow);
+}
+
+namespace {
+
+struct PngSource {
+    const uint8_t* data;
+    size_t len;
+    size_t pos;
+};
+
+void pngRead(png_structp png, png_bytep out, png_size_t count)
+{
+    auto* src = static_cast<PngSource*>(png_get_io_ptr(png));
+    if (count > src->len - src->pos) png_error(png, "Truncated PNG");
+    std::memcpy(out, src->data + src->pos, count);
+    src->pos += count;
+}
+
+void pngError(png_structp png, png_const_charp message)
+{
+    std::cerr << "PNG decode failed: " << message << std::endl;
+    png_longjmp(png, 1);
+}
+
+void pngWarning(png_structp, png_const_charp)
+{
+}
+
+// Same split as the JPEG path: what changes while libpng may longjmp (pngRead, pngError)
+// lives in the caller of the setjmp frame.
+struct PngStream {
+    png_structp png;
+    png_infop info;
+    PngSource source;
+    std::vector<uint8_t> row;
+    std::unique_ptr<RowScaler> scaler;
+};
+
+bool readPngStream(PngStream& stream, const TargetSize& targetSize, const RowScaler::EmitRow& emitRow)
+{
+    png_structp png = stream.png;
+    png_infop info = stream.info;
+    if (setjmp(png_jmpbuf(png))) return false;
+    png_set_read_fn(png, &stream.source, pngRead);
+    png_read_info(png, info);
+
+    png_uint_32 width = png_get_image_width(png, info);
+    png_uint_32 height = png_get_image_height(png, info);
+    if (png_get_interlace_type(png, info) != PNG_INTERLACE_NONE) return false;
+    int dstWidth = 0, dstHeight = 0;
+    if (!targetSize(width, height, dstWidth, dstHeight) || dstWidth <= 0 || dstHeight <= 0) return false;
+    // Everything down to 8 bits RGB while decoding, alpha is dropped like stb_image does.
+    png_set_strip_16(png);
+    png_set_packing(png);
+    png_set_palette_to_rgb(png);
+    png_set_expand_gray_1_2_4_to_8(png);
+    png_set_gray_to_rgb(png);
+    png_set_strip_alpha(png);
+    png_read_update_info(png, info);
+    if (png_get_rowbytes(png, info) != static_cast<size_t>(width) * 3) return false;
+
+    stream.row.resize(static_cast<size_t>(width) * 3);
+    stream.scaler = std::make_unique<RowScaler>(width, height, dstWidth, dstHeight, emitRow);
+    for (png_uint_32 y = 0; y < height; ++y) {
+        png_read_row(png, stream.row.data(), nullptr);
+        stream.scaler->pushRow(stream.row.data());
+    }
+    return true;
+}
+
+}
+
+bool decodePngStreaming(const uint8_t* data, size_t len, const TargetSize& targetSize, const RowScaler::EmitRow& emitRow)
+{
+    if (len < 8 || png_sig_cmp(data, 0, 8) != 0) return false;
+    PngStream stream = {};
+    stream.png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, pngError, pngWarning);
+    if (!stream.png) return false;
+    stream.info = png_create_info_struct(stream.png);
+    if (!stream.info) {
+        png_destroy_read_struct(&stream.png, nullptr, nullptr);
+        return false;
+    }
+    stream.source = {data, len, 0};
+    bool decoded = readPngStream(stream, targetSize, emitRow);
+    png_destroy_read_struct(&stream.png, &stream.info, nullptr);
+    return decoded;
+}
+
+bool decodePngStreaming(const std::string& filename, const TargetSize& targetSize, const RowScaler::EmitRow& emitRow)
+{
+    MappedFile file;
+    if (!file.open(filename)) return false;
+    return decodePngStreaming(file.data(), file.size(), targetSize, emitRow);
+}
+
+bool decodePngToRGB24(const std::string& filename, ImageRGB24& image)
+{
+    // Full size: the scaler only copies the rows.
+    auto targetSize = [&](int width, int height, int& dstWidth, int& dstHeight) {
+        image.width = dstWidth = width;
+        image.height = dstHeight = height;
+        image.data.resize(static_cast<size_t>(width) * height * 3);
+        return true;
+    };
+    auto emitRow = [&](int y, const uint8_t* rgb) {
+        std::memcpy(image.data.data() + static_cast<size_t>(y) * image.width * 3, rgb, static_cast<size_t>(image.width) * 3);
+    };
+    return decodePngStreaming(filename, targetSize, emitRow);
+}
+
 }
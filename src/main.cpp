@@ -1,5 +1,12 @@
 #include "main.hpp"
 #include "video_player.hpp"
+#include "virtual_panel.hpp"
+#include "slideshow.hpp"
+#include "animation_player.hpp"
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
 
 //Pins connection: 
 //  SPI: SPI3_M1 CS0
@@ -9,19 +16,130 @@
 //  RESET: GPIO3_B0
 //  D/C: GPIO3_C1
 
+static void printUsage()
+{
+    std::cerr << "Usage: player <video_file> [--threads n] [--frame-threads | --slice-threads] [--low-delay] [--rgb444] [--virtual [snapshot.ppm]]" << std::endl;
+    std::cerr << "       player <image_dir | list_file> --slideshow [dwell_ms] [--once] [--rgb444] [--virtual [snapshot.ppm]]" << std::endl;
+    std::cerr << "       player <file.gif> --animation [loops] [--rgb444] [--virtual [snapshot.ppm]]" << std::endl;
+}
+
+// Whole non-negative number fitting an int, false for anything else ("12ms", "-1", "").
+static bool parseCount(const char* text, int& value)
+{
+    char* end = nullptr;
+    errno = 0;
+    long parsed = std::strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE || parsed < 0 || parsed > INT_MAX) return false;
+    value = static_cast<int>(parsed);
+    return true;
+}
+
 int main(int argc, char* argv[]) {
     std::cout << av_gettime() << std::endl;
     if (argc < 2) {
-        std::cerr << "Usage: player <video_file>" << std::endl;
+        printUsage();
         return 1;
     }
 
     std::string path = argv[1];
+    bool rgb444 = false;
+    bool useVirtual = false;
+    bool slideshow = false;
+    Slideshow::Options slideshowOptions;
+    bool animation = false;
+    int animationLoops = 0;
+    VideoPlayer::DecoderOptions decoderOptions;
+    std::string snapshotPath;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--rgb444") {
+            rgb444 = true;
+        } else if (arg == "--virtual") {
+            useVirtual = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') snapshotPath = argv[++i];
+        } else if (arg == "--slideshow") {
+            slideshow = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                int dwellMs = 0;
+                if (!parseCount(argv[++i], dwellMs)) {
+                    std::cerr << "Invalid dwell time: " << argv[i] << std::endl;
+                    printUsage();
+                    return 1;
+                }
+                slideshowOptions.dwell = std::chrono::milliseconds(dwellMs);
+            }
+        } else if (arg == "--animation") {
+            animation = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-' && !parseCount(argv[++i], animationLoops)) {
+                std::cerr << "Invalid loop count: " << argv[i] << std::endl;
+                printUsage();
+                return 1;
+            }
+        } else if (arg == "--threads" && i + 1 < argc) {
+            if (!parseCount(argv[++i], decoderOptions.threads)) {
+                std::cerr << "Invalid thread count: " << argv[i] << std::endl;
+                printUsage();
+                return 1;
+            }
+        } else if (arg == "--frame-threads") {
+            decoderOptions.threading = VideoPlayer::DecoderOptions::Threading::Frame;
+        } else if (arg == "--slice-threads") {
+            decoderOptions.threading = VideoPlayer::DecoderOptions::Threading::Slice;
+        } else if (arg == "--low-delay") {
+            decoderOptions.lowDelay = true;
+        } else if (arg == "--once") {
+            slideshowOptions.loop = false;
+        }
+    }
 
-    ST7735S st7735s("/dev/spidev3.0","gpiochip3",8,"gpiochip3",17);
+    // "--virtual" plays into an in-memory panel instead of the board.
+    VirtualPanel* virtualPanel = nullptr;
+    std::unique_ptr<ST7735S> screen;
+    if (useVirtual) {
+        auto panel = std::make_unique<VirtualPanel>();
+        virtualPanel = panel.get();
+        screen = std::make_unique<ST7735S>(std::move(panel));
+    } else {
+        screen = std::make_unique<ST7735S>("/dev/spidev3.0","gpiochip3",8,"gpiochip3",17);
+    }
+    ST7735S& st7735s = *screen;
+    auto reportVirtual = [&]() {
+        if (!virtualPanel) return;
+        virtualPanel->printStats(std::cout);
+        if (!snapshotPath.empty() && !virtualPanel->dumpPPM(snapshotPath)) {
+            std::cerr << "Failed to write " << snapshotPath << std::endl;
+        }
+    };
     st7735s.init();
+    // 12 bits per pixel cuts the bytes per frame by 25%.
+    if (rgb444) st7735s.setPixelFormat(uniframe::PixelFormat::RGB444);
     st7735s.clear();
+    if (slideshow) {
+        Slideshow show(st7735s, Slideshow::loadList(path), slideshowOptions);
+        show.run();
+        Slideshow::Stats stats = show.stats();
+        std::cout << "Slideshow: " << stats.shown << " shown, " << stats.failed << " failed, "
+                  << stats.late << " late (max " << stats.maxLateUs / 1000 << " ms)" << std::endl;
+        reportVirtual();
+        return 0;
+    }
+    if (animation) {
+        AnimationPlayer player(st7735s);
+        if (!player.load(path, uniframe::Orientation::Landscape)) {
+            std::cerr << "Failed to load animation" << std::endl;
+            return 1;
+        }
+        player.play(animationLoops);
+        AnimationPlayer::Stats stats = player.stats();
+        std::cout << "Animation: " << stats.shown << " frames shown, " << stats.bytesSent << " bytes sent, "
+                  << stats.late << " late" << std::endl;
+        reportVirtual();
+        return 0;
+    }
+    // Overlap the SPI transfer of a frame with pacing the next one.
+    st7735s.enableAsync(2);
     VideoPlayer player(st7735s, uniframe::Orientation::Landscape);
+    player.setDecoderOptions(decoderOptions);
     if (!player.load(path)) {
         std::cerr << "Failed to load video" << std::endl;
         return 1;
@@ -32,5 +150,18 @@ int main(int argc, char* argv[]) {
     player.play();
 
     player.wait();
+    VideoPlayer::Stats stats = player.stats();
+    std::cout << "Video: " << stats.shown << " shown, " << stats.late << " late, "
+              << stats.droppedDecode + stats.droppedDisplay << " dropped (" << stats.droppedDecode << " before conversion), "
+              << "skip level " << stats.skipLevel << std::endl;
+    if (stats.seeks > 0) {
+        std::cout << "Seek: " << stats.seeks << " seeks, last " << stats.seekLatencyUs / 1000
+                  << " ms, max " << stats.maxSeekLatencyUs / 1000 << " ms to the first new frame" << std::endl;
+    }
+    if (stats.decoded > 0) {
+        std::cout << "Decode: " << stats.decoded << " frames, " << stats.decodeUs / stats.decoded << " us/frame in the decoder" << std::endl;
+    }
+
+    reportVirtual();
     return 0;
 }
@@ -0,0 +1,166 @@
+#include "panel_group.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <pthread.h>
+#include <stdexcept>
+
+PanelGroup::~PanelGroup()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        running = false;
+    }
+    cv.notify_all();
+    for (auto& bus : buses) {
+        if (bus->worker.joinable()) bus->worker.join();
+    }
+}
+
+int PanelGroup::busOf(const std::string& spi_dev)
+{
+    int bus = -1, cs = -1;
+    size_t pos = spi_dev.rfind("spidev");
+    if (pos == std::string::npos) return -1;
+    if (std::sscanf(spi_dev.c_str() + pos, "spidev%d.%d", &bus, &cs) != 2) return -1;
+    return bus;
+}
+
+size_t PanelGroup::addPanel(ST7735S& panel, int bus)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if (running) {
+        throw std::runtime_error("Panels must be added before the first present");
+    }
+    panels.push_back({&panel, bus, {nullptr, 0}, 0, 0, Clock::time_point()});
+    auto it = std::find_if(buses.begin(), buses.end(), [&](const std::unique_ptr<Bus>& b) { return b->id == bus; });
+    if (it == buses.end()) {
+        buses.push_back(std::make_unique<Bus>());
+        buses.back()->id = bus;
+        it = buses.end() - 1;
+    }
+    (*it)->panels.push_back(panels.size() - 1);
+    return panels.size() - 1;
+}
+
+void PanelGroup::present(const std::vector<Frame>& frames)
+{
+    if (frames.size() != panels.size()) {
+        throw std::runtime_error("One frame per panel expected");
+    }
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [&]() { return busesPending == 0; });
+    if (!running) {
+        running = true;
+        for (auto& bus : buses) {
+            bus->worker = std::thread(&PanelGroup::loopBus, this, std::ref(*bus));
+            pthread_setname_np(bus->worker.native_handle(), "panel-bus");
+        }
+    }
+    // The same number of rounds for every panel, no piece over the quantum.
+    size_t piece = std::max<size_t>(quantum, 1);
+    size_t longest = 0;
+    for (size_t i = 0; i < panels.size(); ++i) {
+        piece = std::min(piece, panels[i].screen->chunkSize());
+        longest = std::max(longest, frames[i].len);
+    }
+    rounds = (longest + piece - 1) / piece;
+    for (size_t i = 0; i < panels.size(); ++i) {
+        panels[i].frame = frames[i];
+        panels[i].offset = 0;
+        panels[i].share = rounds > 0 ? (frames[i].len + rounds - 1) / rounds : 0;
+    }
+    for (auto& bus : buses) bus->roundsDone = 0;
+    busesPending = buses.size();
+    ++generation;
+    lock.unlock();
+    cv.notify_all();
+}
+
+void PanelGroup::wait()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [&]() { return busesPending == 0; });
+}
+
+int64_t PanelGroup::lastSkewUs() const
+{
+    if (panels.empty()) return 0;
+    auto [first, last] = std::minmax_element(panels.begin(), panels.end(),
+        [](const Panel& a, const Panel& b) { return a.done < b.done; });
+    return std::chrono::duration_cast<std::chrono::microseconds>(last->done - first->done).count();
+}
+
+void PanelGroup::loopBus(Bus& bus)
+{
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        cv.wait(lock, [&]() { return !running || generation != seen; });
+        if (!running) break;
+        seen = generation;
+        lock.unlock();
+
+        try {
+            writeBus(bus);
+        } catch (const std::exception& e) {
+            std::cerr << "[PanelGroup] bus " << bus.id << ": " << e.what() << std::endl;
+        }
+
+        lock.lock();
+        // A failed bus must not hold the others back.
+        bus.roundsDone = rounds;
+        --busesPending;
+        cv.notify_all();
+    }
+}
+
+void PanelGroup::writeBus(Bus& bus)
+{
+    const size_t count = bus.panels.size();
+    const size_t first = bus.rotation;
+    bus.rotation = (bus.rotation + 1) % count;
+
+    for (size_t k = 0; k < count; ++k) {
+        Panel& panel = panels[bus.panels[(first + k) % count]];
+        panel.screen->startWrite();
+        if (panel.frame.len == 0) panel.done = Clock::now();
+    }
+    // Each panel keeps its own address counter while the others hold the bus,
+    // so the frames are sent one share per panel in turn, round after round.
+    for (size_t round = 0; round < rounds; ++round) {
+        if (!awaitRound(round)) return;
+        for (size_t k = 0; k < count; ++k) {
+            Panel& panel = panels[bus.panels[(first + k) % count]];
+            size_t left = panel.frame.len - panel.offset;
+            if (left == 0) continue;
+            size_t chunk = std::min(left, panel.share);
+            panel.screen->writeData(panel.frame.data + panel.offset, chunk);
+            panel.offset += chunk;
+            if (panel.offset == panel.frame.len) panel.done = Clock::now();
+        }
+        finishRound(bus, round);
+    }
+}
+
+bool PanelGroup::awaitRound(size_t round)
+{
+    if (buses.size() == 1 || round == 0) return true;
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [&]() {
+        return !running || std::all_of(buses.begin(), buses.end(),
+            [&](const std::unique_ptr<Bus>& b) { return b->roundsDone >= round; });
+    });
+    return running;
+}
+
+void PanelGroup::finishRound(Bus& bus, size_t round)
+{
+    if (buses.size() == 1) return;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        bus.roundsDone = round + 1;
+    }
+    cv.notify_all();
+}
@@ -0,0 +1,195 @@
+#include "partial_updater.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+PartialUpdater::PartialUpdater(ST7735S& screen, int bytesPerPixel)
+    : screen(screen), bytesPerPixel(bytesPerPixel)
+{
+}
+
+void PartialUpdater::invalidate()
+{
+    valid = false;
+}
+
+size_t PartialUpdater::cost(const Rect& rect) const
+{
+    return windowCostBytes + static_cast<size_t>(rect.width) * rect.height * bytesPerPixel;
+}
+
+PartialUpdater::Rect PartialUpdater::unite(const Rect& a, const Rect& b)
+{
+    int x = std::min(a.x, b.x);
+    int y = std::min(a.y, b.y);
+    int xE = std::max(a.x + a.width, b.x + b.width);
+    int yE = std::max(a.y + a.height, b.y + b.height);
+    return {x, y, xE - x, yE - y};
+}
+
+const std::vector<PartialUpdater::Rect>& PartialUpdater::track(const uint8_t* frame, size_t stride, int frameWidth, int frameHeight)
+{
+    size_t rowBytes = static_cast<size_t>(frameWidth) * bytesPerPixel;
+    if (!valid || frameWidth != width || frameHeight != height) {
+        width = frameWidth;
+        height = frameHeight;
+        shadow.resize(rowBytes * height);
+        for (int y = 0; y < height; ++y) {
+            std::memcpy(shadow.data() + y * rowBytes, frame + y * stride, rowBytes);
+        }
+        valid = true;
+        rects.assign(1, Rect{0, 0, width, height});
+        return rects;
+    }
+    detect(frame, stride);
+    merge();
+    return rects;
+}
+
+size_t PartialUpdater::present(const uint8_t* frame, size_t stride)
+{
+    const ST7735S::Window& current = screen.window;
+    int widthNow = current.xE - current.xS + 1;
+    int heightNow = current.yE - current.yS + 1;
+
+    if (current.xS != window.xS || current.yS != window.yS) valid = false;
+    bool resync = !valid || widthNow != width || heightNow != height;
+    window = current;
+    track(frame, stride, widthNow, heightNow);
+    if (resync) {
+        screen.writeFrame(shadow.data(), shadow.size());
+        return shadow.size();
+    }
+
+    size_t bytesSent = 0;
+    for (const auto& rect : rects) {
+        send(rect);
+        bytesSent += static_cast<size_t>(rect.width) * rect.height * bytesPerPixel;
+    }
+    // Leave the full window behind for the other writers.
+    bool fullWindow = rects.size() == 1 && rects[0].width == width && rects[0].height == height;
+    if (!rects.empty() && !fullWindow) {
+        screen.rangeSet(window.xS, window.xE, window.yS, window.yE);
+    }
+    return bytesSent;
+}
+
+void PartialUpdater::detect(const uint8_t* frame, size_t stride)
+{
+    const int tilesX = (width + tileSize - 1) / tileSize;
+    const int tilesY = (height + tileSize - 1) / tileSize;
+    const size_t rowBytes = static_cast<size_t>(width) * bytesPerPixel;
+    const size_t tileBytes = static_cast<size_t>(tileSize) * bytesPerPixel;
+    tiles.assign(tilesX * tilesY, 0);
+    rects.clear();
+
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* src = frame + y * stride;
+        uint8_t* dst = shadow.data() + y * rowBytes;
+        if (std::memcmp(src, dst, rowBytes) == 0) continue;
+        uint8_t* tileRow = tiles.data() + (y / tileSize) * tilesX;
+        for (int tx = 0; tx < tilesX; ++tx) {
+            size_t offset = tx * tileBytes;
+            size_t len = std::min(tileBytes, rowBytes - offset);
+            if (std::memcmp(src + offset, dst + offset, len) != 0) {
+                tileRow[tx] = 1;
+            }
+        }
+        std::memcpy(dst, src, rowBytes);
+    }
+
+    // Runs of dirty tiles in each tile row, stacked with the run above when
+    // both cover the same columns.
+    size_t openBegin = 0;
+    for (int ty = 0; ty < tilesY; ++ty) {
+        size_t openEnd = rects.size();
+        int y = ty * tileSize;
+        int h = std::min(tileSize, height - y);
+        for (int tx = 0; tx < tilesX;) {
+            if (!tiles[ty * tilesX + tx]) {
+                ++tx;
+                continue;
+            }
+            int runStart = tx;
+            while (tx < tilesX && tiles[ty * tilesX + tx]) ++tx;
+            int x = runStart * tileSize;
+            int w = std::min(tx * tileSize, width) - x;
+
+            bool stacked = false;
+            for (size_t i = openBegin; i < openEnd; ++i) {
+                Rect& above = rects[i];
+                if (above.x == x && above.width == w && above.y + above.height == y) {
+                    above.height += h;
+                    stacked = true;
+                    break;
+                }
+            }
+            if (!stacked) rects.push_back({x, y, w, h});
+        }
+        // Only the rectangles touching this row can still grow.
+        size_t next = rects.size();
+        for (size_t i = openBegin; i < rects.size(); ++i) {
+            if (rects[i].y + rects[i].height == y + h) {
+                next = std::min(next, i);
+            }
+        }
+        openBegin = next;
+    }
+}
+
+void PartialUpdater::merge()
+{
+    if (rects.size() < 2) return;
+
+    Rect bounds = rects[0];
+    size_t total = 0;
+    for (const auto& rect : rects) {
+        bounds = unite(bounds, rect);
+        total += cost(rect);
+    }
+    // Scattered changes: one bounding box is cheaper, or the pairwise search
+    // below would cost more than it saves.
+    if (total >= cost(bounds) || rects.size() > 4 * maxRects) {
+        rects.assign(1, bounds);
+        return;
+    }
+
+    // Merge the pair with the lowest extra cost while merging pays off or
+    // while there are too many rectangles.
+    while (rects.size() > 1) {
+        size_t bestI = 0, bestJ = 0;
+        long long bestDelta = std::numeric_limits<long long>::max();
+        for (size_t i = 0; i < rects.size(); ++i) {
+            for (size_t j = i + 1; j < rects.size(); ++j) {
+                long long delta = static_cast<long long>(cost(unite(rects[i], rects[j])))
+                    - static_cast<long long>(cost(rects[i]) + cost(rects[j]));
+                if (delta < bestDelta) {
+                    bestDelta = delta;
+                    bestI = i;
+                    bestJ = j;
+                }
+            }
+        }
+        if (bestDelta > 0 && rects.size() <= maxRects) break;
+        rects[bestI] = unite(rects[bestI], rects[bestJ]);
+        rects.erase(rects.begin() + bestJ);
+    }
+}
+
+void PartialUpdater::send(const Rect& rect)
+{
+    const size_t rowBytes = static_cast<size_t>(width) * bytesPerPixel;
+    const size_t rectRowBytes = static_cast<size_t>(rect.width) * bytesPerPixel;
+    scratch.resize(rectRowBytes * rect.height);
+    for (int y = 0; y < rect.height; ++y) {
+        std::memcpy(scratch.data() + y * rectRowBytes,
+                    shadow.data() + (rect.y + y) * rowBytes + rect.x * bytesPerPixel,
+                    rectRowBytes);
+    }
+    if (rect.width != width || rect.height != height) {
+        screen.rangeSet(window.xS + rect.x, window.xS + rect.x + rect.width - 1,
+                        window.yS + rect.y, window.yS + rect.y + rect.height - 1);
+    }
+    screen.writeFrame(scratch.data(), scratch.size());
+}
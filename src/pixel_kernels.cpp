@@ -0,0 +1,380 @@
+#include "pixel_kernels.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PIXKERNEL_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define PIXKERNEL_NEON 1
+#include <arm_neon.h>
+#if !defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+namespace pixkernel {
+
+namespace scalar {
+
+void rgb888ToRGB565BE(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    for (size_t i = 0; i < pixels; ++i, src += 3, dst += 2) {
+        dst[0] = (src[0] & 0xF8) | (src[1] >> 5);
+        dst[1] = ((src[1] & 0x1C) << 3) | (src[2] >> 3);
+    }
+}
+
+void rgb888ToRGB565LE(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    for (size_t i = 0; i < pixels; ++i, src += 3, dst += 2) {
+        dst[0] = ((src[1] & 0x1C) << 3) | (src[2] >> 3);
+        dst[1] = (src[0] & 0xF8) | (src[1] >> 5);
+    }
+}
+
+void rgbaToRGB565BE(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    for (size_t i = 0; i < pixels; ++i, src += 4, dst += 2) {
+        dst[0] = (src[0] & 0xF8) | (src[1] >> 5);
+        dst[1] = ((src[1] & 0x1C) << 3) | (src[2] >> 3);
+    }
+}
+
+void byteswap16(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    for (size_t i = 0; i < count; ++i, src += 2, dst += 2) {
+        uint8_t hi = src[0];
+        dst[0] = src[1];
+        dst[1] = hi;
+    }
+}
+
+void fill(uint8_t* dst, size_t len, const uint8_t* pattern, size_t patternLen)
+{
+    if (patternLen == 0) return;
+    for (size_t i = 0; i < len; i += patternLen) {
+        std::memcpy(dst + i, pattern, std::min(patternLen, len - i));
+    }
+}
+
+}
+
+namespace {
+
+#ifdef PIXKERNEL_X86
+
+// RGBx pixels in 32 bits lanes -> RGB565 in the low half of each lane,
+// sign extended so the signed 32 -> 16 bits pack keeps the value.
+__attribute__((target("sse2"))) inline __m128i packLanes565(__m128i p)
+{
+    __m128i r = _mm_and_si128(_mm_srli_epi32(p, 3), _mm_set1_epi32(0x1F));
+    __m128i g = _mm_and_si128(_mm_srli_epi32(p, 10), _mm_set1_epi32(0x3F));
+    __m128i b = _mm_and_si128(_mm_srli_epi32(p, 19), _mm_set1_epi32(0x1F));
+    __m128i v = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(r, 11), _mm_slli_epi32(g, 5)), b);
+    return _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+}
+
+__attribute__((target("sse2"))) inline __m128i swapBytes16(__m128i v)
+{
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+__attribute__((target("avx2"))) inline __m256i packLanes565(__m256i p)
+{
+    __m256i r = _mm256_and_si256(_mm256_srli_epi32(p, 3), _mm256_set1_epi32(0x1F));
+    __m256i g = _mm256_and_si256(_mm256_srli_epi32(p, 10), _mm256_set1_epi32(0x3F));
+    __m256i b = _mm256_and_si256(_mm256_srli_epi32(p, 19), _mm256_set1_epi32(0x1F));
+    __m256i v = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(r, 11), _mm256_slli_epi32(g, 5)), b);
+    return _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+}
+
+__attribute__((target("avx2"))) inline __m256i swapBytes16(__m256i v)
+{
+    return _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8));
+}
+
+__attribute__((target("sse2"))) void rgbaToRGB565BESSE2(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    size_t i = 0;
+    for (; i + 8 <= pixels; i += 8) {
+        __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+        __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4 + 16));
+        __m128i v = _mm_packs_epi32(packLanes565(p0), packLanes565(p1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2), swapBytes16(v));
+    }
+    scalar::rgbaToRGB565BE(src + i * 4, dst + i * 2, pixels - i);
+}
+
+__attribute__((target("sse2"))) void byteswap16SSE2(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2), swapBytes16(v));
+    }
+    scalar::byteswap16(src + i * 2, dst + i * 2, count - i);
+}
+
+__attribute__((target("sse2"))) void fillSSE2(uint8_t* dst, size_t len, const uint8_t* pattern, size_t patternLen)
+{
+    // 48 bytes hold a whole number of 1, 2, 3, 4, 6... bytes patterns.
+    uint8_t block[48];
+    if (patternLen == 0 || 48 % patternLen != 0 || len < sizeof(block)) {
+        scalar::fill(dst, len, pattern, patternLen);
+        return;
+    }
+    scalar::fill(block, sizeof(block), pattern, patternLen);
+    __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+    __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16));
+    __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 32));
+    size_t i = 0;
+    for (; i + sizeof(block) <= len; i += sizeof(block)) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v0);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 16), v1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 32), v2);
+    }
+    std::memcpy(dst + i, block, len - i);
+}
+
+// Spreads 4 RGB888 pixels (12 bytes) to 32 bits lanes, needs SSSE3 (pshufb).
+template <bool bigEndian>
+__attribute__((target("ssse3"))) void rgb888ToRGB565SSSE3(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    const __m128i spread = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    size_t i = 0;
+    // Each load reads 16 bytes for 12 used, stay 2 pixels away from the end.
+    for (; i + 10 <= pixels; i += 8) {
+        __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3));
+        __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3 + 12));
+        __m128i v = _mm_packs_epi32(packLanes565(_mm_shuffle_epi8(p0, spread)), packLanes565(_mm_shuffle_epi8(p1, spread)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2), bigEndian ? swapBytes16(v) : v);
+    }
+    if (bigEndian) {
+        scalar::rgb888ToRGB565BE(src + i * 3, dst + i * 2, pixels - i);
+    } else {
+        scalar::rgb888ToRGB565LE(src + i * 3, dst + i * 2, pixels - i);
+    }
+}
+
+// 8 RGB888 pixels (24 bytes, reads 28) -> RGB565 in the low half of 32 bits lanes
+__attribute__((target("avx2"))) inline __m256i loadRGB888x8(const uint8_t* p)
+{
+    const __m256i spread = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                            0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 12));
+    return packLanes565(_mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1), spread));
+}
+
+template <bool bigEndian>
+__attribute__((target("avx2"))) void rgb888ToRGB565AVX2(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    size_t i = 0;
+    for (; i + 18 <= pixels; i += 16) {
+        __m256i v = _mm256_packs_epi32(loadRGB888x8(src + i * 3), loadRGB888x8(src + i * 3 + 24));
+        // The pack works per 128 bits lane, put the quarters back in order.
+        v = _mm256_permute4x64_epi64(v, 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 2), bigEndian ? swapBytes16(v) : v);
+    }
+    if (bigEndian) {
+        scalar::rgb888ToRGB565BE(src + i * 3, dst + i * 2, pixels - i);
+    } else {
+        scalar::rgb888ToRGB565LE(src + i * 3, dst + i * 2, pixels - i);
+    }
+}
+
+__attribute__((target("avx2"))) void rgbaToRGB565BEAVX2(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        __m256i p0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+        __m256i p1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4 + 32));
+        __m256i v = _mm256_permute4x64_epi64(_mm256_packs_epi32(packLanes565(p0), packLanes565(p1)), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 2), swapBytes16(v));
+    }
+    scalar::rgbaToRGB565BE(src + i * 4, dst + i * 2, pixels - i);
+}
+
+__attribute__((target("avx2"))) void byteswap16AVX2(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 2));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 2), swapBytes16(v));
+    }
+    scalar::byteswap16(src + i * 2, dst + i * 2, count - i);
+}
+
+__attribute__((target("avx2"))) void fillAVX2(uint8_t* dst, size_t len, const uint8_t* pattern, size_t patternLen)
+{
+    uint8_t block[96];
+    if (patternLen == 0 || 96 % patternLen != 0 || len < sizeof(block)) {
+        fillSSE2(dst, len, pattern, patternLen);
+        return;
+    }
+    scalar::fill(block, sizeof(block), pattern, patternLen);
+    __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+    __m256i v2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 64));
+    size_t i = 0;
+    for (; i + sizeof(block) <= len; i += sizeof(block)) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), v0);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 32), v1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 64), v2);
+    }
+    std::memcpy(dst + i, block, len - i);
+}
+
+#endif
+
+#ifdef PIXKERNEL_NEON
+
+template <bool bigEndian>
+void rgb888ToRGB565NEON(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        uint8x16x3_t p = vld3q_u8(src + i * 3);
+        uint8x16_t hi = vorrq_u8(vandq_u8(p.val[0], vdupq_n_u8(0xF8)), vshrq_n_u8(p.val[1], 5));
+        uint8x16_t lo = vorrq_u8(vshlq_n_u8(vandq_u8(p.val[1], vdupq_n_u8(0x1C)), 3), vshrq_n_u8(p.val[2], 3));
+        uint8x16x2_t out;
+        out.val[0] = bigEndian ? hi : lo;
+        out.val[1] = bigEndian ? lo : hi;
+        vst2q_u8(dst + i * 2, out);
+    }
+    if (bigEndian) {
+        scalar::rgb888ToRGB565BE(src + i * 3, dst + i * 2, pixels - i);
+    } else {
+        scalar::rgb888ToRGB565LE(src + i * 3, dst + i * 2, pixels - i);
+    }
+}
+
+void rgbaToRGB565BENEON(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        uint8x16x4_t p = vld4q_u8(src + i * 4);
+        uint8x16x2_t out;
+        out.val[0] = vorrq_u8(vandq_u8(p.val[0], vdupq_n_u8(0xF8)), vshrq_n_u8(p.val[1], 5));
+        out.val[1] = vorrq_u8(vshlq_n_u8(vandq_u8(p.val[1], vdupq_n_u8(0x1C)), 3), vshrq_n_u8(p.val[2], 3));
+        vst2q_u8(dst + i * 2, out);
+    }
+    scalar::rgbaToRGB565BE(src + i * 4, dst + i * 2, pixels - i);
+}
+
+void byteswap16NEON(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        vst1q_u8(dst + i * 2, vrev16q_u8(vld1q_u8(src + i * 2)));
+    }
+    scalar::byteswap16(src + i * 2, dst + i * 2, count - i);
+}
+
+void fillNEON(uint8_t* dst, size_t len, const uint8_t* pattern, size_t patternLen)
+{
+    uint8_t block[48];
+    if (patternLen == 0 || 48 % patternLen != 0 || len < sizeof(block)) {
+        scalar::fill(dst, len, pattern, patternLen);
+        return;
+    }
+    scalar::fill(block, sizeof(block), pattern, patternLen);
+    uint8x16_t v0 = vld1q_u8(block);
+    uint8x16_t v1 = vld1q_u8(block + 16);
+    uint8x16_t v2 = vld1q_u8(block + 32);
+    size_t i = 0;
+    for (; i + sizeof(block) <= len; i += sizeof(block)) {
+        vst1q_u8(dst + i, v0);
+        vst1q_u8(dst + i + 16, v1);
+        vst1q_u8(dst + i + 32, v2);
+    }
+    std::memcpy(dst + i, block, len - i);
+}
+
+#endif
+
+std::vector<Kernels> supported()
+{
+    // Each entry builds on the previous one, the best comes last.
+    std::vector<Kernels> list;
+    Kernels k = {"scalar", scalar::rgb888ToRGB565BE, scalar::rgb888ToRGB565LE,
+                 scalar::rgbaToRGB565BE, scalar::byteswap16, scalar::fill};
+    list.push_back(k);
+#ifdef PIXKERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        k = {"sse2", scalar::rgb888ToRGB565BE, scalar::rgb888ToRGB565LE,
+             rgbaToRGB565BESSE2, byteswap16SSE2, fillSSE2};
+        list.push_back(k);
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        k.name = "ssse3";
+        k.rgb888ToRGB565BE = rgb888ToRGB565SSSE3<true>;
+        k.rgb888ToRGB565LE = rgb888ToRGB565SSSE3<false>;
+        list.push_back(k);
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        k = {"avx2", rgb888ToRGB565AVX2<true>, rgb888ToRGB565AVX2<false>,
+             rgbaToRGB565BEAVX2, byteswap16AVX2, fillAVX2};
+        list.push_back(k);
+    }
+#endif
+#ifdef PIXKERNEL_NEON
+#if !defined(__aarch64__)
+    // NEON is optional on 32 bits ARM
+    if (!(getauxval(AT_HWCAP) & HWCAP_NEON)) return list;
+#endif
+    k = {"neon", rgb888ToRGB565NEON<true>, rgb888ToRGB565NEON<false>,
+         rgbaToRGB565BENEON, byteswap16NEON, fillNEON};
+    list.push_back(k);
+#endif
+    return list;
+}
+
+const Kernels& kernels()
+{
+    return available().back();
+}
+
+}
+
+const std::vector<Kernels>& available()
+{
+    static const std::vector<Kernels> list = supported();
+    return list;
+}
+
+void rgb888ToRGB565BE(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    kernels().rgb888ToRGB565BE(src, dst, pixels);
+}
+
+void rgb888ToRGB565LE(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    kernels().rgb888ToRGB565LE(src, dst, pixels);
+}
+
+void rgbaToRGB565BE(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    kernels().rgbaToRGB565BE(src, dst, pixels);
+}
+
+void byteswap16(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    kernels().byteswap16(src, dst, count);
+}
+
+void fill(uint8_t* dst, size_t len, const uint8_t* pattern, size_t patternLen)
+{
+    kernels().fill(dst, len, pattern, patternLen);
+}
+
+const char* active()
+{
+    return kernels().name;
+}
+
+}
@@ -0,0 +1,201 @@
+#include "slideshow.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <dirent.h>
+#include <sys/stat.h>
+
+Slideshow::Slideshow(ST7735S& screen, std::vector<std::string> paths, const Options& options)
+    : screen(screen), paths(std::move(paths)), options(options)
+{
+    this->options.prefetch = std::max<size_t>(this->options.prefetch, 1);
+    this->options.workers = std::max<size_t>(this->options.workers, 1);
+}
+
+Slideshow::~Slideshow()
+{
+    stop();
+}
+
+std::vector<std::string> Slideshow::loadList(const std::string& path)
+{
+    std::vector<std::string> list;
+    struct stat st;
+    if (::stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+        // Extensions stb_image (and the JPEG decoder) know about
+        static const char* extensions[] = {"jpg", "jpeg", "png", "bmp", "gif", "tga", "psd", "hdr", "pic", "ppm", "pgm"};
+        DIR* dir = opendir(path.c_str());
+        if (!dir) return list;
+        while (dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            size_t dot = name.rfind('.');
+            if (name[0] == '.' || dot == std::string::npos) continue;
+            std::string ext = name.substr(dot + 1);
+            std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+            if (std::any_of(std::begin(extensions), std::end(extensions), [&](const char* e) { return ext == e; })) {
+                list.push_back(path + "/" + name);
+            }
+        }
+        closedir(dir);
+        std::sort(list.begin(), list.end());
+        return list;
+    }
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        list.push_back(line);
+    }
+    return list;
+}
+
+uint64_t Slideshow::endSeq() const
+{
+    return options.loop ? std::numeric_limits<uint64_t>::max() : paths.size();
+}
+
+size_t Slideshow::reserveBytes() const
+{
+    return uniframe::frameBytes(screen.pixelFormat(), static_cast<size_t>(screen.screenWidth) * screen.screenHeight);
+}
+
+bool Slideshow::canClaim() const
+{
+    if (nextJob >= endSeq() || nextJob > nextShow + options.prefetch) return false;
+    return slots.empty() || bytesHeld + reserveBytes() <= options.memoryBudget;
+}
+
+void Slideshow::run()
+{
+    if (paths.empty()) return;
+    std::unique_lock<std::mutex> lock(mtx);
+    running = true;
+    nextJob = 0;
+    nextShow = 0;
+    for (size_t i = 0; i < options.workers; ++i) {
+        workers.emplace_back(&Slideshow::loopWorker, this);
+    }
+
+    bool first = true;
+    Clock::time_point showAt = Clock::now();
+    while (running && nextShow < endSeq()) {
+        cv.wait(lock, [&]() {
+            return !running || (!slots.empty() && slots.front().seq == nextShow && slots.front().state != SlotState::Working);
+        });
+        if (!running) break;
+        Slot slot = std::move(slots.front());
+        slots.pop_front();
+        bytesHeld -= slot.bytes;
+        ++nextShow;
+        cv.notify_all();
+        if (slot.state == SlotState::Failed) {
+            ++counters.failed;
+            // Nothing to show at all, do not spin on the list.
+            if (counters.failed >= paths.size() && counters.shown == 0) break;
+            continue;
+        }
+        if (cv.wait_until(lock, showAt, [&]() { return !running; })) break;
+        lock.unlock();
+
+        Clock::time_point now = Clock::now();
+        int64_t lateUs = std::chrono::duration_cast<std::chrono::microseconds>(now - showAt).count();
+        // Letterbox bars only need clearing when the window changes.
+        const ST7735S::Window& w = slot.image.layout.window;
+        if (first || w.xS != screen.window.xS || w.xE != screen.window.xE || w.yS != screen.window.yS || w.yE != screen.window.yE) {
+            screen.clear();
+        }
+        screen.showImage(slot.image.layout, slot.image.data.data(), slot.image.data.size());
+
+        lock.lock();
+        ++counters.shown;
+        // A late image gets its full dwell, the schedule restarts from it.
+        if (!first && lateUs > 1000) {
+            ++counters.late;
+            counters.maxLateUs = std::max(counters.maxLateUs, lateUs);
+            showAt = now;
+        } else if (first) {
+            showAt = now;
+        }
+        showAt += options.dwell;
+        first = false;
+    }
+    // The last image stays for its dwell too.
+    if (running && counters.shown > 0) cv.wait_until(lock, showAt, [&]() { return !running; });
+
+    running = false;
+    lock.unlock();
+    cv.notify_all();
+    for (auto& worker : workers) worker.join();
+    workers.clear();
+    lock.lock();
+    slots.clear();
+    bytesHeld = 0;
+}
+
+void Slideshow::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        running = false;
+    }
+    cv.notify_all();
+}
+
+Slideshow::Stats Slideshow::stats()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return counters;
+}
+
+void Slideshow::loopWorker()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        cv.wait(lock, [&]() { return !running || canClaim(); });
+        if (!running) break;
+        uint64_t seq = nextJob++;
+        size_t reserved = reserveBytes();
+        slots.push_back({seq, SlotState::Working, {}, reserved});
+        bytesHeld += reserved;
+        const std::string& path = paths[seq % paths.size()];
+        lock.unlock();
+
+        ST7735S::PreparedImage image;
+        bool prepared = false;
+        try {
+            prepared = prepare(path, image);
+        } catch (const std::exception& e) {
+            std::cerr << "[Slideshow] " << path << ": " << e.what() << std::endl;
+        }
+
+        lock.lock();
+        // The display loop only pops finished slots, "seq" is still in the queue.
+        Slot& slot = slots[seq - slots.front().seq];
+        bytesHeld -= slot.bytes;
+        slot.bytes = prepared ? image.data.size() : 0;
+        bytesHeld += slot.bytes;
+        slot.image = std::move(image);
+        slot.state = prepared ? SlotState::Ready : SlotState::Failed;
+        cv.notify_all();
+    }
+}
+
+bool Slideshow::prepare(const std::string& path, ST7735S::PreparedImage& image)
+{
+    std::string key;
+    if (options.cache) {
+        key = ImageCache::key(path, screen.screenWidth, screen.screenHeight, options.orientation, screen.pixelFormat());
+        if (auto cached = options.cache->find(key)) {
+            image.layout = cached->layout();
+            image.data.assign(cached->data(), cached->data() + cached->size());
+            return true;
+        }
+    }
+    if (!screen.prepareImage(path, options.orientation, image)) return false;
+    if (!key.empty()) options.cache->store(key, image.layout, image.data.data(), image.data.size());
+    return true;
+}
@@ -0,0 +1,126 @@
+#include "spidev_transport.hpp"
+#include "st7735s.hpp"
+#include <gpiod.hpp>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <cerrno>
+#include <stdexcept>
+#include <fstream>
+#include <vector>
+
+struct SpidevTransport::Lines {
+    gpiod::line rst;
+    gpiod::line dc;
+};
+
+// Defined here rather than in st7735s.cpp, so ST7735S links without libgpiod.
+ST7735S::ST7735S(const std::string& spi_dev, 
+    const std::string& gpio_chip_name_rst, 
+    const uint8_t gpio_offset_rst, 
+    const std::string& gpio_chip_name_dc,  
+    const uint8_t gpio_offset_dc)
+    : transport(std::make_unique<SpidevTransport>(spi_dev, gpio_chip_name_rst, gpio_offset_rst,
+        gpio_chip_name_dc, gpio_offset_dc, speed))
+{
+    adaptChunkSize();
+}
+
+SpidevTransport::SpidevTransport(const std::string& spi_dev,
+    const std::string& gpio_chip_name_rst,
+    const uint8_t gpio_offset_rst,
+    const std::string& gpio_chip_name_dc,
+    const uint8_t gpio_offset_dc,
+    uint32_t speed)
+    : lines(std::make_unique<Lines>()), speed(speed)
+{
+    spi_fd = open(spi_dev.c_str(), O_RDWR);
+    if (spi_fd < 0) {
+        throw std::runtime_error("Failed to open SPI device" + spi_dev);
+    }
+
+    // SPI configuration
+    uint32_t mode = SPI_MODE_0;
+    uint8_t bits = 8;
+    if(ioctl(spi_fd, SPI_IOC_WR_MODE, &mode) < 0) {
+        close(spi_fd);
+        throw std::runtime_error("Failed to set SPI mode");
+    }
+    if(ioctl(spi_fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed) < 0) {
+        close(spi_fd);
+        throw std::runtime_error("Failed to set SPI speed");
+    }
+    if(ioctl(spi_fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0) {
+        close(spi_fd);
+        throw std::runtime_error("Failed to set SPI bits per word");
+    }
+
+    gpiod::chip chip_rst(gpio_chip_name_rst);
+    gpiod::chip chip_dc(gpio_chip_name_dc);
+    lines->rst = chip_rst.get_line(gpio_offset_rst);
+    lines->dc = chip_dc.get_line(gpio_offset_dc);
+
+    if (lines->rst.is_used() || lines->dc.is_used()) {
+        close(spi_fd);
+        throw std::runtime_error("GPIO pins are in use");
+    }
+
+    lines->rst.request({"st7735s_rst", gpiod::line_request::DIRECTION_OUTPUT, 0}, 1);
+    lines->dc.request({"st7735s_dc", gpiod::line_request::DIRECTION_OUTPUT, 0}, 1);
+
+    bufsiz = detectBufsiz();
+    if (bufsiz == 0) {
+        lines->rst.release();
+        lines->dc.release();
+        close(spi_fd);
+        throw std::runtime_error("Failed to probe the SPI message size");
+    }
+}
+
+SpidevTransport::~SpidevTransport()
+{
+    lines->rst.release();
+    lines->dc.release();
+    close(spi_fd);
+}
+
+void SpidevTransport::setRST(bool level)
+{
+    lines->rst.set_value(level ? 1 : 0);
+}
+
+void SpidevTransport::setDC(bool level)
+{
+    lines->dc.set_value(level ? 1 : 0);
+}
+
+void SpidevTransport::transfer(const spi_ioc_transfer* segments, size_t count)
+{
+    if (ioctl(spi_fd, SPI_IOC_MESSAGE(count), segments) < 0) {
+        throw std::runtime_error("SPI transfer failed");
+    }
+}
+
+size_t SpidevTransport::detectBufsiz()
+{
+    std::ifstream param("/sys/module/spidev/parameters/bufsiz");
+    size_t value = 0;
+    if (param >> value && value > 0) return value;
+
+    // spidev built into the kernel without sysfs: probe with NOP (0x00) commands,
+    // a message over bufsiz fails with EMSGSIZE. Any other error is a real one, 0.
+    const size_t probeMax = 65536;
+    const size_t probeMin = 4096;
+    std::vector<uint8_t> nop(probeMax, 0x00);
+    setDC(false);
+    for (size_t size = probeMax; size > probeMin; size /= 2) {
+        spi_ioc_transfer tr = {};
+        tr.tx_buf = (unsigned long)nop.data();
+        tr.len = static_cast<unsigned int>(size);
+        tr.speed_hz = speed;
+        tr.bits_per_word = 8;
+        if (ioctl(spi_fd, SPI_IOC_MESSAGE(1), &tr) >= 0) return size;
+        if (errno != EMSGSIZE) return 0;
+    }
+    return probeMin;
+}
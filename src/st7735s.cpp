@@ -1,86 +1,204 @@
 #include <st7735s.hpp>
-#include <fcntl.h>
-#include <unistd.h>
-#include <sys/ioctl.h>
-#include <linux/spi/spidev.h>
+#include "pixel_kernels.hpp"
+#include "image_cache.hpp"
 #include <stdexcept>
 #include <iostream>
 #include <chrono>
 #include <thread>
 #include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <pthread.h>
 
-ST7735S::ST7735S(const std::string& spi_dev, 
-    const std::string& gpio_chip_name_rst, 
-    const uint8_t gpio_offset_rst, 
-    const std::string& gpio_chip_name_dc,  
-    const uint8_t gpio_offset_dc)
+ST7735S::ST7735S(std::unique_ptr<Transport> transport)
+    : transport(std::move(transport))
 {
-    spi_fd = open(spi_dev.c_str(), O_RDWR);
-    if (spi_fd < 0) {
-        throw std::runtime_error("Failed to open SPI device" + spi_dev);
-    }
+    adaptChunkSize();
+}
 
-    // SPI configuration
-    uint32_t mode = SPI_MODE_0;
-    uint8_t bits = 8;
-    if(ioctl(spi_fd, SPI_IOC_WR_MODE, &mode) < 0) {
-        throw std::runtime_error("Failed to set SPI mode");
-    }
-    if(ioctl(spi_fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed) < 0) {
-        throw std::runtime_error("Failed to set SPI speed");
+void ST7735S::adaptChunkSize()
+{
+    maxSPIChunkSize = std::max<size_t>(transport->maxTransferSize(), 1);
+    reportChunkSize();
+}
+
+void ST7735S::reportChunkSize() const
+{
+    size_t frameBytes = uniframe::frameBytes(pixelFormatBus, static_cast<size_t>(screenWidth) * screenHeight);
+    std::cout << "[ST7735S] SPI message limit: " << maxSPIChunkSize << " bytes, "
+              << transfersPerFrame(frameBytes) << " transfer(s) per full frame" << std::endl;
+}
+
+size_t ST7735S::transfersPerFrame(size_t frameBytes) const
+{
+    return (frameBytes + maxSPIChunkSize - 1) / maxSPIChunkSize;
+}
+
+ST7735S::~ST7735S()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtxImage);
+        upgradeRunning = false;
     }
-    if(ioctl(spi_fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0) {
-        throw std::runtime_error("Failed to set SPI bits per word");
+    cvImage.notify_all();
+    if (threadUpgrade.joinable()) threadUpgrade.join();
+    disableAsync();
+}
+
+void ST7735S::Batch::cmd(uint8_t cmd)
+{
+    segments.push_back({false, nullptr, inlineBytes.size(), 1});
+    inlineBytes.push_back(cmd);
+}
+
+void ST7735S::Batch::data(const uint8_t* data, size_t len)
+{
+    if (len == 0) return;
+    segments.push_back({true, data, 0, len});
+}
+
+void ST7735S::Batch::data(std::initializer_list<uint8_t> bytes)
+{
+    if (bytes.size() == 0) return;
+    segments.push_back({true, nullptr, inlineBytes.size(), bytes.size()});
+    inlineBytes.insert(inlineBytes.end(), bytes.begin(), bytes.end());
+}
+
+void ST7735S::Batch::delay(uint16_t ms)
+{
+    segments.push_back({false, nullptr, 0, 0, ms});
+}
+
+void ST7735S::Batch::clear()
+{
+    segments.clear();
+    inlineBytes.clear();
+}
+
+void ST7735S::spiTransfer(bool isData, const spi_ioc_transfer* segments, size_t count)
+{
+    if (dcLevel != static_cast<int>(isData)) {
+        transport->setDC(isData);
+        dcLevel = isData ? 1 : 0;
     }
+    transport->transfer(segments, count);
+}
+
+namespace {
+
+// Settling requirements from the datasheet, every other command can follow back to back.
+struct CommandTiming {
+    uint8_t cmd;
+    // Before any next command
+    uint16_t settleMs;
+    // Before the next SLPIN / SLPOUT
+    uint16_t sleepToggleMs;
+};
 
-    gpiod::chip chip_rst(gpio_chip_name_rst);
-    gpiod::chip chip_dc(gpio_chip_name_dc);
-    gpio_line_rst = chip_rst.get_line(gpio_offset_rst);
-    gpio_line_dc = chip_dc.get_line(gpio_offset_dc);
+constexpr CommandTiming commandTimings[] = {
+    {0x01, 5, 120}, // SWRESET
+    {0x10, 5, 120}, // SLPIN
+    {0x11, 5, 120}, // SLPOUT
+};
 
-    if (gpio_line_rst.is_used() || gpio_line_dc.is_used()) {
-        throw std::runtime_error("GPIO pins are in use");
+constexpr const CommandTiming* commandTiming(uint8_t cmd)
+{
+    for (const auto& timing : commandTimings) {
+        if (timing.cmd == cmd) return &timing;
     }
+    return nullptr;
+}
 
-    gpio_line_rst.request({"st7735s_rst", gpiod::line_request::DIRECTION_OUTPUT, 0}, 1);
-    gpio_line_dc.request({"st7735s_dc", gpiod::line_request::DIRECTION_OUTPUT, 0}, 1);
 }
 
-ST7735S::~ST7735S()
+void ST7735S::awaitCommand(uint8_t cmd)
 {
-    gpio_line_rst.release();
-    gpio_line_dc.release();
-    close(spi_fd);
+    Clock::time_point deadline = readyAt;
+    if (cmd == 0x10 || cmd == 0x11) deadline = std::max(deadline, sleepToggleAt);
+    if (Clock::now() < deadline) {
+        flushTransfers();
+        std::this_thread::sleep_until(deadline);
+    }
 }
 
-void ST7735S::spiTransfer(bool isData, const uint8_t* data, size_t len)
+void ST7735S::scheduleCommand(uint8_t cmd)
 {
-    gpio_line_dc.set_value(isData ? 1 : 0);
-    struct spi_ioc_transfer tr = {
-        .tx_buf = (unsigned long)data,
-        .len = static_cast<unsigned int>(len),
-        .speed_hz = speed,
-        .delay_usecs = 0,
-        .bits_per_word = 8
-    };
-    if (ioctl(spi_fd, SPI_IOC_MESSAGE(1), &tr) < 0) {
-        throw std::runtime_error("SPI transfer failed");
-    }
+    const CommandTiming* timing = commandTiming(cmd);
+    if (!timing) return;
+    // The deadline starts when the command is on the wire.
+    flushTransfers();
+    Clock::time_point now = Clock::now();
+    readyAt = now + std::chrono::milliseconds(timing->settleMs);
+    sleepToggleAt = now + std::chrono::milliseconds(timing->sleepToggleMs);
 }
 
-void ST7735S::writeCmd(uint8_t cmd)
+void ST7735S::holdBus(uint16_t ms)
 {
-    spiTransfer(false, &cmd, 1);
+    flushTransfers();
+    readyAt = std::max(readyAt, Clock::now() + std::chrono::milliseconds(ms));
 }
 
-void ST7735S::writeData(const uint8_t* data, size_t len)
+void ST7735S::queueTransfer(bool isData, const uint8_t* data, size_t len)
 {
+    if (!isData && len > 0) awaitCommand(data[0]);
     size_t offset = 0;
     while (offset < len) {
         size_t chunkSize = std::min(maxSPIChunkSize, len - offset);
-        spiTransfer(true, data + offset, chunkSize);
+        // D/C is a GPIO, it can only change between two messages.
+        // spidev also limits the total length of one message to its bufsiz.
+        if (!transfers.empty() && (transfersIsData != isData ||
+            transfersLen + chunkSize > maxSPIChunkSize ||
+            transfers.size() == maxSPISegments)) {
+            flushTransfers();
+        }
+        spi_ioc_transfer tr = {};
+        tr.tx_buf = (unsigned long)(data + offset);
+        tr.len = static_cast<unsigned int>(chunkSize);
+        tr.speed_hz = speed;
+        tr.delay_usecs = 0;
+        tr.bits_per_word = 8;
+        transfers.push_back(tr);
+        transfersIsData = isData;
+        transfersLen += chunkSize;
         offset += chunkSize;
     }
+    if (!isData && len > 0) scheduleCommand(data[0]);
+}
+
+void ST7735S::flushTransfers()
+{
+    if (transfers.empty()) return;
+    spiTransfer(transfersIsData, transfers.data(), transfers.size());
+    transfers.clear();
+    transfersLen = 0;
+}
+
+void ST7735S::submit(const Batch& batch)
+{
+    std::lock_guard<std::mutex> lock(mtxBus);
+    for (const auto& segment : batch.segments) {
+        if (segment.len == 0) {
+            if (segment.delayMs > 0) holdBus(segment.delayMs);
+            continue;
+        }
+        const uint8_t* data = segment.ptr ? segment.ptr : batch.inlineBytes.data() + segment.offset;
+        queueTransfer(segment.isData, data, segment.len);
+    }
+    flushTransfers();
+}
+
+void ST7735S::writeCmd(uint8_t cmd)
+{
+    std::lock_guard<std::mutex> lock(mtxBus);
+    queueTransfer(false, &cmd, 1);
+    flushTransfers();
+}
+
+void ST7735S::writeData(const uint8_t* data, size_t len)
+{
+    std::lock_guard<std::mutex> lock(mtxBus);
+    queueTransfer(true, data, len);
+    flushTransfers();
 }
 
 void ST7735S::writeData(uint8_t singleByte)
@@ -88,6 +206,142 @@ void ST7735S::writeData(uint8_t singleByte)
     writeData(&singleByte, 1);
 }
 
+void ST7735S::writeFrame(const uint8_t* data, size_t len)
+{
+    writeFrame(data, len, 1, len);
+}
+
+void ST7735S::writeFrame(const uint8_t* base, size_t rowBytes, int rows, size_t stride)
+{
+    std::lock_guard<std::mutex> lock(mtxBus);
+    uint8_t cmd = 0x2C;
+    queueTransfer(false, &cmd, 1);
+    if (stride == rowBytes) {
+        queueTransfer(true, base, rowBytes * rows);
+    } else {
+        for (int y = 0; y < rows; ++y) {
+            queueTransfer(true, base + y * stride, rowBytes);
+        }
+    }
+    flushTransfers();
+}
+
+void ST7735S::enableAsync(size_t slots)
+{
+    std::lock_guard<std::mutex> lock(mtxAsync);
+    if (asyncRunning) return;
+    frameSlots.assign(std::max<size_t>(slots, 2), FrameSlot());
+    slotHead = 0;
+    slotTail = 0;
+    slotsQueued = 0;
+    asyncRunning = true;
+    threadWriter = std::thread(&ST7735S::loopWriter, this);
+    pthread_setname_np(threadWriter.native_handle(), "st7735s-writer");
+}
+
+void ST7735S::disableAsync()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtxAsync);
+        if (!asyncRunning) return;
+        asyncRunning = false;
+    }
+    cvAsync.notify_all();
+    if (threadWriter.joinable()) threadWriter.join();
+}
+
+void ST7735S::loopWriter()
+{
+    std::unique_lock<std::mutex> lock(mtxAsync);
+    while (true) {
+        cvAsync.wait(lock, [&]() { return !asyncRunning || slotsQueued > 0; });
+        // Queued frames are still written when stopping.
+        if (slotsQueued == 0) break;
+        FrameSlot& slot = frameSlots[slotTail];
+        lock.unlock();
+
+        try {
+            writeFrame(slot.base, slot.rowBytes, slot.rows, slot.stride);
+        } catch (const std::exception& e) {
+            std::cerr << "[Writer] " << e.what() << std::endl;
+        }
+
+        lock.lock();
+        fenceCompleted.store(slot.fence);
+        slotTail = (slotTail + 1) % frameSlots.size();
+        --slotsQueued;
+        cvAsync.notify_all();
+    }
+}
+
+ST7735S::Fence ST7735S::submitFrame(const uint8_t* data, size_t len)
+{
+    return submitSlot(data, len, 1, len, true);
+}
+
+ST7735S::Fence ST7735S::submitFrame(const uint8_t* base, size_t rowBytes, int rows, size_t stride)
+{
+    return submitSlot(base, rowBytes, rows, stride, false);
+}
+
+ST7735S::Fence ST7735S::submitSlot(const uint8_t* base, size_t rowBytes, int rows, size_t stride, bool copy)
+{
+    size_t index;
+    {
+        std::lock_guard<std::mutex> lock(mtxAsync);
+        if (!asyncRunning) {
+            writeFrame(base, rowBytes, rows, stride);
+            fenceCompleted.store(++fenceSubmitted);
+            return fenceSubmitted;
+        }
+        if (slotsQueued == frameSlots.size()) return 0;
+        index = slotHead;
+    }
+
+    // The head slot is not touched by the writer until it is queued.
+    FrameSlot& slot = frameSlots[index];
+    if (copy) {
+        slot.data.resize(rowBytes * rows);
+        for (int y = 0; y < rows; ++y) {
+            std::memcpy(slot.data.data() + y * rowBytes, base + y * stride, rowBytes);
+        }
+        base = slot.data.data();
+        stride = rowBytes;
+    }
+    slot.base = base;
+    slot.rowBytes = rowBytes;
+    slot.rows = rows;
+    slot.stride = stride;
+
+    Fence fence;
+    {
+        std::lock_guard<std::mutex> lock(mtxAsync);
+        fence = ++fenceSubmitted;
+        slot.fence = fence;
+        slotHead = (slotHead + 1) % frameSlots.size();
+        ++slotsQueued;
+    }
+    cvAsync.notify_all();
+    return fence;
+}
+
+void ST7735S::waitSlot()
+{
+    std::unique_lock<std::mutex> lock(mtxAsync);
+    cvAsync.wait(lock, [&]() { return !asyncRunning || slotsQueued < frameSlots.size(); });
+}
+
+bool ST7735S::fenceDone(Fence fence) const
+{
+    return fenceCompleted.load() >= fence;
+}
+
+void ST7735S::waitFence(Fence fence)
+{
+    std::unique_lock<std::mutex> lock(mtxAsync);
+    cvAsync.wait(lock, [&]() { return !asyncRunning || fenceCompleted.load() >= fence; });
+}
+
 void ST7735S::startWrite()
 {
     writeCmd(0x2C);
@@ -100,77 +354,37 @@ void ST7735S::delay_ms(uint64_t ms)
 
 void ST7735S::reset()
 {
+    std::lock_guard<std::mutex> lock(mtxBus);
     // Set RST to "0" for reset.
-    gpio_line_rst.set_value(0);
-    delay_ms(50);
-    gpio_line_rst.set_value(1);
+    transport->setRST(false);
     delay_ms(50);
+    transport->setRST(true);
+    // Reset cancel: 120ms before the next command and before SLPOUT.
+    readyAt = Clock::now() + std::chrono::milliseconds(120);
+    sleepToggleAt = readyAt;
 }
 
-void ST7735S::init()
+void ST7735S::init(const paneltable::Table& table)
 {
-    // Panel Resolution Select:
-    // GM2=0 GM1=1 GM0=1
-    // 128RGB * 160 (S7~390 and G2~161 output)
-    // S:LCD Source Driver[396:1]
-    // G:LCD Gate   Driver[162:1]
     reset();
-    sleepMode(false); // Awake
-    // Pixel Format
-    writeCmd(0x3A);
-    writeData(0x55); // RGB565
-
-    // Gamma select
-    writeCmd(0x26);
-    writeData(0x03);
-    // gammaCorrect();
-
-    // FPS formula: fps = 200kHz/(line+VPA[5:0])(DIVA[4:0]+4)
-    // when GM = 011(128*160), line = 160
-    // FPS select (normal mode, full colors)
-    writeCmd(0XB1); // normal mode
-    writeData(0x06);
-    writeData(0x0A); // fps: 117
-    writeCmd(0XB2); // idle mode
-    writeData(0x06);
-    writeData(0x0A); // fps: 117
-    writeCmd(0XB3); // partial mode
-    writeData(0x06);
-    writeData(0x0A); // fps: 117
-
-    // Display Inversion Control (refresh by line or frame)
-    writeCmd(0xB4);
-    writeData(0x02);
-    // Power control: GVDD and voltage
-    writeCmd(0xC0);
-    writeData(0x0A);
-    writeData(0x02);
-    // Power control: AVDD, VCL, VGH and VGL supply power level
-    writeCmd(0xC1);
-    writeData(0x02);
-    // Power control: Set VCOMH, VCOML Voltage
-    writeCmd(0xC5);
-    writeData(0x4F);
-    writeData(0x5A);
-    // VCOM Offset Control
-    writeCmd(0xC7);
-    writeData(0x40);
-
-    colorInversion(false);
-    colorOrderRGB(true);
-
-    // rangeReset();
-    idleMode(false);
-
-    // Source Driver Direction Control
-    writeCmd(0xB7);
-    writeData(0x00);
-    // Gate Driver Direction Control
-    writeCmd(0xB8);
-    writeData(0x00);
-
-    // Display On
-    writeCmd(0x29);
+    playTable(table);
+}
+
+void ST7735S::playTable(const paneltable::Table& table)
+{
+    Batch batch;
+    for (size_t i = 0; i < table.count; ++i) {
+        const paneltable::Step& step = table.steps[i];
+        batch.cmd(step.cmd);
+        batch.data(step.data, step.len);
+        if (step.delayMs > 0) batch.delay(step.delayMs);
+        // Keep the cached register in sync with what the table wrote.
+        if (step.cmd == 0x36 && step.len > 0) MADCTL = step.data[0];
+        if (step.cmd == 0x3A && step.len > 0) {
+            pixelFormatBus = (step.data[0] & 0x07) == 0x03 ? uniframe::PixelFormat::RGB444 : uniframe::PixelFormat::RGB565;
+        }
+    }
+    submit(batch);
 }
 
 void ST7735S::colorInversion(bool inversion)
@@ -180,26 +394,13 @@ void ST7735S::colorInversion(bool inversion)
 
 void ST7735S::sleepMode(bool on)
 {
+    // Settling is enforced by the command scheduler before the next command.
     writeCmd(on ? 0x10 : 0x11);
-    delay_ms(on ? 5 : 120);
 }
 
 void ST7735S::gammaCorrect()
 {
-    // Enable Gamma correction
-    writeCmd(0xF2);
-    // Set positive Gamma correction
-    writeCmd(0xE0);
-    uint8_t gammaCorrectionPositive[] = {
-        0x3F, 0x25, 0x1C, 0x1E, 0x20, 0x12, 0x2A, 0x90, 0x24, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00
-    };
-    writeData(gammaCorrectionPositive, sizeof(gammaCorrectionPositive));
-    // Set negative Gamma correction
-    writeCmd(0xE1);
-    uint8_t gammaCorrectionNegative[] = {
-        0x20, 0x20, 0x20, 0x20, 0x05, 0x00, 0x15, 0xA7, 0x3D, 0x18, 0x25, 0x2A, 0x2B, 0x2B, 0x3A
-    };
-    writeData(gammaCorrectionNegative, sizeof(gammaCorrectionNegative));
+    playTable(paneltable::gammaST7735S);
 }
 
 uint16_t ST7735S::RGB888ToRGB565(uint32_t color)
@@ -212,28 +413,47 @@ uint16_t ST7735S::RGB888ToRGB565(uint32_t color)
 
 void ST7735S::fillWith(uint32_t color_rgb888)
 {
-    uint16_t color = RGB888ToRGB565(color_rgb888);
-    uint8_t high = (color >> 8) & 0xFF;
-    uint8_t low = color & 0xFF;
-    size_t buf_size = 4096;
+    // One pixel (RGB565) or a pixel pair (RGB444) repeated
+    std::vector<uint8_t> pattern;
+    if (pixelFormatBus == uniframe::PixelFormat::RGB444) {
+        uint8_t r = (color_rgb888 >> 20) & 0x0F;
+        uint8_t g = (color_rgb888 >> 12) & 0x0F;
+        uint8_t b = (color_rgb888 >> 4) & 0x0F;
+        pattern = {static_cast<uint8_t>(r << 4 | g), static_cast<uint8_t>(b << 4 | r), static_cast<uint8_t>(g << 4 | b)};
+    } else {
+        uint16_t color = RGB888ToRGB565(color_rgb888);
+        pattern = {static_cast<uint8_t>((color >> 8) & 0xFF), static_cast<uint8_t>(color & 0xFF)};
+    }
+    size_t buf_size = 4096 - 4096 % pattern.size();
     std::vector<uint8_t> buffer(buf_size);
 
     // auto start = std::chrono::high_resolution_clock::now();
 
-    for (size_t i = 0; i < buf_size; i += 2) {
-        buffer[i] = high;
-        buffer[i+1] = low;
-    }
+    pixkernel::fill(buffer.data(), buf_size, pattern.data(), pattern.size());
 
     // auto end = std::chrono::high_resolution_clock::now();
     // auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end-start);
     // std::cout << "Time spent:" << duration.count() << "μs" << std::endl;
 
     rangeReset();
-    startWrite();
-    for (uint8_t i = 0; i < 10; i++) {
-        writeData(buffer.data(), buf_size);
+    size_t total = uniframe::frameBytes(pixelFormatBus, static_cast<size_t>(screenWidth) * screenHeight);
+    Batch batch;
+    batch.cmd(0x2C);
+    for (size_t offset = 0; offset < total; offset += buf_size) {
+        batch.data(buffer.data(), std::min(buf_size, total - offset));
     }
+    submit(batch);
+}
+
+void ST7735S::setPixelFormat(uniframe::PixelFormat format)
+{
+    Batch batch;
+    batch.cmd(0x3A);
+    batch.data({static_cast<uint8_t>(format == uniframe::PixelFormat::RGB444 ? 0x03 : 0x05)});
+    submit(batch);
+    pixelFormatBus = format;
+    // Frames got smaller (or larger), report the transfers they take now.
+    reportChunkSize();
 }
 
 void ST7735S::clear()
@@ -253,15 +473,16 @@ void ST7735S::idleMode(bool on)
 
 void ST7735S::rangeSet(uint8_t xS, uint8_t xE, uint8_t yS, uint8_t yE)
 {
-    delay_ms(10);
     uint8_t xBuf[] = {0x00, xS, 0x00, xE};
     uint8_t yBuf[] = {0x00, yS, 0x00, yE};
     // printf("rangeSet: %d, %d, %d, %d\n", xBuf[1], xBuf[3], yBuf[1], yBuf[3]);
-    writeCmd(0x2A);
-    writeData(xBuf, sizeof(xBuf));
-    writeCmd(0x2B);
-    writeData(yBuf, sizeof(yBuf));
-    delay_ms(10);
+    Batch batch;
+    batch.cmd(0x2A);
+    batch.data(xBuf, sizeof(xBuf));
+    batch.cmd(0x2B);
+    batch.data(yBuf, sizeof(yBuf));
+    submit(batch);
+    window = {xS, xE, yS, yE};
 }
 
 void ST7735S::rangeReset()
@@ -271,8 +492,10 @@ void ST7735S::rangeReset()
 
 void ST7735S::setMADCTL()
 {
-    writeCmd(0x36);
-    writeData(static_cast<uint8_t>(MADCTL.to_ulong()));
+    Batch batch;
+    batch.cmd(0x36);
+    batch.data({static_cast<uint8_t>(MADCTL.to_ulong())});
+    submit(batch);
 }
 
 void ST7735S::refreshDirection(bool ml, bool mh)
@@ -325,7 +548,7 @@ void ST7735S::orientationSet(uniframe::Orientation orientation)
     setMADCTL();
 }
 
-void ST7735S::rangeAdapt(int widthImage, int heightImage, uniframe::Orientation orientation)
+ST7735S::Window ST7735S::fitWindow(int widthImage, int heightImage, uniframe::Orientation orientation, DisplayArea& area) const
 {
     double ratioImage = static_cast<double>(widthImage) / heightImage;
     double ratioScreenLandscape = static_cast<double>(screenHeight) / screenWidth;
@@ -335,73 +558,238 @@ void ST7735S::rangeAdapt(int widthImage, int heightImage, uniframe::Orientation
 
     if (orientation == uniframe::Orientation::Landscape || orientation == uniframe::Orientation::LandscapeInverted) {
         if (ratioImage >= ratioScreenLandscape) {
-            displayArea.displayWidth = screenHeight;
-            displayArea.displayHeight = static_cast<int>(std::round(screenHeight / ratioImage));
+            area.displayWidth = screenHeight;
+            area.displayHeight = static_cast<int>(std::round(screenHeight / ratioImage));
         } else {
-            displayArea.displayHeight = screenWidth;
-            displayArea.displayWidth = static_cast<int>(std::round(screenWidth * ratioImage));
+            area.displayHeight = screenWidth;
+            area.displayWidth = static_cast<int>(std::round(screenWidth * ratioImage));
         }
-        xS = static_cast<uint8_t>(std::round((static_cast<double>(screenHeight) - displayArea.displayWidth) / 2.0));
-        xE = xS + displayArea.displayWidth - 1;
-        yS = static_cast<uint8_t>(std::round((static_cast<double>(screenWidth) - displayArea.displayHeight) / 2.0));
-        yE = yS + displayArea.displayHeight - 1;
+        xS = static_cast<uint8_t>(std::round((static_cast<double>(screenHeight) - area.displayWidth) / 2.0));
+        xE = xS + area.displayWidth - 1;
+        yS = static_cast<uint8_t>(std::round((static_cast<double>(screenWidth) - area.displayHeight) / 2.0));
+        yE = yS + area.displayHeight - 1;
     } else {
         if (ratioImage <= ratioScreenPortrait) {
-            displayArea.displayHeight = screenHeight;
-            displayArea.displayWidth = static_cast<int>(std::round(static_cast<double>(screenHeight) * ratioImage));
+            area.displayHeight = screenHeight;
+            area.displayWidth = static_cast<int>(std::round(static_cast<double>(screenHeight) * ratioImage));
         } else {
-            displayArea.displayWidth = screenWidth;
-            displayArea.displayHeight = static_cast<int>(std::round(static_cast<double>(screenWidth) / ratioImage));
+            area.displayWidth = screenWidth;
+            area.displayHeight = static_cast<int>(std::round(static_cast<double>(screenWidth) / ratioImage));
         }
-        xS = static_cast<uint8_t>(std::round((static_cast<double>(screenWidth) - displayArea.displayWidth) / 2.0));
-        xE = xS + static_cast<uint8_t>(displayArea.displayWidth) - 1;
-        yS = static_cast<uint8_t>(std::round((static_cast<double>(screenHeight) - displayArea.displayHeight) / 2.0));
-        yE = yS + static_cast<uint8_t>(displayArea.displayHeight) - 1;
+        xS = static_cast<uint8_t>(std::round((static_cast<double>(screenWidth) - area.displayWidth) / 2.0));
+        xE = xS + static_cast<uint8_t>(area.displayWidth) - 1;
+        yS = static_cast<uint8_t>(std::round((static_cast<double>(screenHeight) - area.displayHeight) / 2.0));
+        yE = yS + static_cast<uint8_t>(area.displayHeight) - 1;
     }
     // std::cout << "X: " << std::dec << static_cast<int>(xS) << " - " << static_cast<int>(xE) << std::endl; 
     // std::cout << "Y: " << std::dec << static_cast<int>(yS) << " - " << static_cast<int>(yE) << std::endl;
+    return {xS, xE, yS, yE};
+}
+
+void ST7735S::rangeAdapt(int widthImage, int heightImage, uniframe::Orientation orientation)
+{
+    Window fit = fitWindow(widthImage, heightImage, orientation, displayArea);
     orientationSet(orientation);
-    rangeSet(xS, xE, yS, yE);
+    rangeSet(fit.xS, fit.xE, fit.yS, fit.yE);
 }
 
 void ST7735S::imagePlay(std::string& path, uniframe::Orientation orientation)
 {
+    std::unique_lock<std::mutex> lock(mtxImage);
+    ++imageGeneration;
+
+    // A cached image is one mmap and one burst on the bus.
+    std::string key = imageCache ? ImageCache::key(path, screenWidth, screenHeight, orientation, pixelFormatBus) : "";
+    if (!key.empty()) {
+        if (auto cached = imageCache->find(key)) {
+            clear();
+            showImage(cached->layout(), cached->data(), cached->size());
+            return;
+        }
+    }
+
+    PreparedImage image;
+    if (!prepareImage(path, orientation, image, exifThumbnails)) return;
     clear();
-    imghandler::ImageRGB565 image565;
-    imghandler::ImageRGB24 image24Src;
-    imghandler::ImageRGB24 image24Dst;
-
-    // imghandler::ImageType imageType = imghandler::formatProbe(path);
-    // switch (imageType)
-    // {
-    // case imghandler::ImageType::JPG:
-    //     if (!imghandler::decodeJpegToRGB24(path, image24Src)) {
-    //         std::cout << "Decode failed" << std::endl;
-    //         return;
-    //     }
-    //     break;
-    // default:
-    //     std::cout << "Unknown image format" << std::endl;
-    //     break;
-    // }
-    
-    if (!imghandler::decodeImageToRGB24(path, image24Src)) {
-        std::cout << "Decode failed" << std::endl;
+    showImage(image.layout, image.data.data(), image.data.size());
+
+    if (!image.thumbnail) {
+        if (!key.empty()) imageCache->store(key, image.layout, image.data.data(), image.data.size());
         return;
     }
-    rangeAdapt(image24Src.width, image24Src.height, orientation);
-    if (!imghandler::scaleImage(image24Src, image24Dst, displayArea.displayWidth, displayArea.displayHeight)) {
+    if (exifUpgrade) {
+        upgradePath = path;
+        upgradeKey = key;
+        upgradeOrientation = orientation;
+        upgradeGeneration = imageGeneration;
+        upgradePending = true;
+        if (!upgradeRunning) {
+            upgradeRunning = true;
+            threadUpgrade = std::thread(&ST7735S::loopUpgrade, this);
+            pthread_setname_np(threadUpgrade.native_handle(), "st7735s-upgrade");
+        }
+        lock.unlock();
+        cvImage.notify_one();
+    }
+}
+
+bool ST7735S::prepareImage(const std::string& path, uniframe::Orientation orientation, PreparedImage& image, bool exifThumbnail) const
+{
+    // Decoded pixels stay in a per-thread buffer, reused from one image to the next while
+    // it is about the panel size (EXIF thumbnails, small images). A full resolution decode
+    // gives its memory back once scaled, every slideshow worker would keep its largest one.
+    thread_local imghandler::ImageRGB24 image24Src;
+    struct Trim {
+        std::vector<uint8_t>& data;
+        size_t keep;
+        ~Trim() { if (data.capacity() > keep) std::vector<uint8_t>().swap(data); }
+    } trim{image24Src.data, static_cast<size_t>(screenWidth) * screenHeight * 3 * 4};
+
+    imghandler::ImageType type = imghandler::ImageType::Unknown;
+    try {
+        type = imghandler::formatProbe(path);
+    } catch (const std::exception&) {
+    }
+    if (type == imghandler::ImageType::WEBP) {
+        std::cout << "WebP is not supported" << std::endl;
+        return false;
+    }
+    bool isJpeg = type == imghandler::ImageType::JPG;
+    bool landscape = orientation == uniframe::Orientation::Landscape || orientation == uniframe::Orientation::LandscapeInverted;
+    int boxWidth = landscape ? screenHeight : screenWidth;
+    int boxHeight = landscape ? screenWidth : screenHeight;
+    // The EXIF thumbnail is usually about the panel size and takes a few ms to decode.
+    image.thumbnail = isJpeg && exifThumbnail && imghandler::decodeExifThumbnailToRGB24(path, image24Src, boxWidth, boxHeight);
+    image.layout.orientation = orientation;
+    image.layout.format = pixelFormatBus;
+    // JPEG and PNG are decoded row by row straight into the panel format,
+    // stb_image takes the rest and whatever they refuse (e.g. interlaced PNG).
+    bool streamable = isJpeg || type == imghandler::ImageType::PNG;
+    if (streamable && !image.thumbnail && prepareStreaming(path, type, image)) return true;
+    bool decoded = image.thumbnail || imghandler::decodeImageToRGB24(path, image24Src);
+    if (!decoded) {
+        std::cout << "Decode failed" << std::endl;
+        return false;
+    }
+
+    image.layout.window = fitWindow(image24Src.width, image24Src.height, orientation, image.layout.area);
+    const DisplayArea& area = image.layout.area;
+    // The output goes into the caller's buffer, its capacity is reused.
+    bool scaled;
+    if (image.layout.format == uniframe::PixelFormat::RGB444) {
+        imghandler::ImageRGB444 image444;
+        image444.data.swap(image.data);
+        scaled = imghandler::scaleToRGB444(image24Src, image444, area.displayWidth, area.displayHeight);
+        image.data.swap(image444.data);
+    } else {
+        imghandler::ImageRGB565 image565;
+        image565.data.swap(image.data);
+        scaled = imghandler::scaleToRGB565(image24Src, image565, area.displayWidth, area.displayHeight);
+        image.data.swap(image565.data);
+    }
+    if (!scaled) {
         std::cout << "Scale failed" << std::endl;
-        return;
+        return false;
     }
-    if (!imghandler::convertToRGB565(image24Dst, image565)) {
-        std::cout << "Convert failed" << std::endl;
-        return;
+    // std::cout << "Display area: " << std::dec << area.displayWidth << " * " << area.displayHeight << std::endl;
+    return true;
+}
+
+bool ST7735S::prepareStreaming(const std::string& path, imghandler::ImageType type, PreparedImage& image) const
+{
+    // RGB444 pairs can span two rows, those rows are packed at the end.
+    thread_local std::vector<uint8_t> rows444;
+    const bool rgb444 = image.layout.format == uniframe::PixelFormat::RGB444;
+    const DisplayArea& area = image.layout.area;
+    auto targetSize = [&](int width, int height, int& dstWidth, int& dstHeight) {
+        image.layout.window = fitWindow(width, height, image.layout.orientation, image.layout.area);
+        dstWidth = area.displayWidth;
+        dstHeight = area.displayHeight;
+        size_t pixels = static_cast<size_t>(dstWidth) * dstHeight;
+        if (rgb444) {
+            rows444.resize(pixels * 3);
+        } else {
+            image.data.resize(pixels * 2);
+        }
+        return true;
+    };
+    auto emitRow = [&](int y, const uint8_t* rgb) {
+        size_t width = area.displayWidth;
+        if (rgb444) {
+            std::memcpy(rows444.data() + y * width * 3, rgb, width * 3);
+        } else {
+            pixkernel::rgb888ToRGB565BE(rgb, image.data.data() + y * width * 2, width);
+        }
+    };
+    bool decoded = type == imghandler::ImageType::PNG ? imghandler::decodePngStreaming(path, targetSize, emitRow)
+                                                      : imghandler::decodeJpegStreaming(path, targetSize, emitRow);
+    if (!decoded) return false;
+    if (rgb444) {
+        image.data.resize(uniframe::frameBytes(uniframe::PixelFormat::RGB444, static_cast<size_t>(area.displayWidth) * area.displayHeight));
+        imghandler::packRGB24ToRGB444(rows444.data(), area.displayWidth * 3, area.displayWidth, area.displayHeight, image.data.data());
+    }
+    return true;
+}
+
+bool ST7735S::showImage(const ImageLayout& layout, const uint8_t* data, size_t len)
+{
+    if (layout.format != pixelFormatBus) {
+        std::cout << "Image prepared for another pixel format" << std::endl;
+        return false;
+    }
+    displayArea = layout.area;
+    orientationSet(layout.orientation);
+    rangeSet(layout.window.xS, layout.window.xE, layout.window.yS, layout.window.yE);
+    writeFrame(data, len);
+    return true;
+}
+
+void ST7735S::useExifThumbnails(bool enable, bool upgrade)
+{
+    std::lock_guard<std::mutex> lock(mtxImage);
+    exifThumbnails = enable;
+    exifUpgrade = upgrade;
+}
+
+void ST7735S::setImageCache(ImageCache* cache)
+{
+    std::lock_guard<std::mutex> lock(mtxImage);
+    imageCache = cache;
+}
+
+void ST7735S::loopUpgrade()
+{
+    std::unique_lock<std::mutex> lock(mtxImage);
+    while (true) {
+        cvImage.wait(lock, [&]() { return upgradePending || !upgradeRunning; });
+        if (!upgradeRunning) break;
+        upgradePending = false;
+        std::string path = upgradePath;
+        std::string key = upgradeKey;
+        uniframe::Orientation orientation = upgradeOrientation;
+        uint64_t generation = upgradeGeneration;
+        lock.unlock();
+
+        PreparedImage image;
+        bool prepared = false;
+        try {
+            prepared = prepareImage(path, orientation, image, false);
+        } catch (const std::exception& e) {
+            std::cerr << "[ST7735S] upgrade: " << e.what() << std::endl;
+        }
+
+        lock.lock();
+        // Dropped when another image was played meanwhile.
+        if (!prepared || generation != imageGeneration) continue;
+        try {
+            const Window& w = image.layout.window;
+            if (w.xS != window.xS || w.xE != window.xE || w.yS != window.yS || w.yE != window.yE) clear();
+            showImage(image.layout, image.data.data(), image.data.size());
+            if (imageCache && !key.empty()) imageCache->store(key, image.layout, image.data.data(), image.data.size());
+        } catch (const std::exception& e) {
+            std::cerr << "[ST7735S] upgrade: " << e.what() << std::endl;
+        }
     }
-    // std::cout << "Display area: " << std::dec << displayArea.displayWidth << " * " << displayArea.displayHeight << std::endl;
-    // std::cout << "data size: " << std::dec << image565.width << " * " << image565.height << " = " << image565.data.size() << std::endl;
-    startWrite();
-    writeData(image565.data.data(), image565.data.size());
 }
 
 void ST7735S::testSetRange()
@@ -418,6 +806,5 @@ void ST7735S::testSetRange()
         buffer[i] = 0x0A;
         buffer[i+1] = 0x3C;
     }
-    startWrite();
-    writeData(buffer.data(), buffer.size());
+    writeFrame(buffer.data(), buffer.size());
 }
\ No newline at end of file
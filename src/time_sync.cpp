@@ -10,4 +10,9 @@ void TimeSync::resetPtsBaseUs(us_t pts) {
     std::lock_guard<std::mutex> lock(mtx);
     if (ptsBaseUs < 0) ptsBaseUs = ptsUs;
     return uniTimeStartUs + static_cast<int64_t>(std::llround((ptsUs - ptsBaseUs) / speed));
-}
\ No newline at end of file
+}
+
+bool TimeSync::started() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return ptsBaseUs >= 0;
+}
@@ -7,36 +7,16 @@
 
 namespace uniframe {
 
-// FramePool::FramePool(size_t maxsize)
-// {
-//     for (size_t i = 0; i < maxsize; ++i) {
-//         pool.push(std::make_unique<ImageRGB565>());
-//     }
-// }
-
-// FramePool::~FramePool()
-// {
-
-// }
-
-// std::unique_ptr<ImageRGB565> FramePool::acquire()
-// {
-//     std::lock_guard<std::mutex> lock(mtx);
-//     if (!pool.empty()) {
-//         auto frame = std::move(pool.front());
-//         pool.pop();
-//         return frame;
-//     } else {
-//         std::cerr << "[WARN] FramePool depleted" << std::endl;
-//         return nullptr;
-//     }
-// }
-
-// void FramePool::release(std::unique_ptr<ImageRGB565> frameRaw)
-// {
-//     std::lock_guard<std::mutex> lock(mtx);
-//     pool.push(std::move(frameRaw));
-// }
-
+size_t frameBytes(PixelFormat format, size_t pixels)
+{
+    switch (format) {
+    case PixelFormat::RGB444:
+        // Pixels go in pairs, an odd count is padded.
+        return (pixels + 1) / 2 * 3;
+    case PixelFormat::RGB565:
+    default:
+        return pixels * 2;
+    }
+}
 
 }
\ No newline at end of file
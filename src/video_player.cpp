@@ -3,6 +3,10 @@
 #include <termios.h>
 #include <unistd.h>
 #include <algorithm> 
+#include <fstream>
+#include <sstream>
+#include <dirent.h>
+#include <pthread.h>
 
 # include "video_player.hpp"
 
@@ -22,10 +26,51 @@ namespace {
             tcsetattr(STDIN_FILENO, TCSAFLUSH, &orig);
         }
     };
+
+    // avcodec_open2() with the calling thread renamed meanwhile: FFmpeg starts its workers
+    // there and they inherit the name, which sets them apart from the thread that loaded.
+    int openCodec(AVCodecContext* ctx, const AVCodec* codec)
+    {
+        char name[16] = "";
+        pthread_getname_np(pthread_self(), name, sizeof(name));
+        pthread_setname_np(pthread_self(), "av-worker");
+        int ret = avcodec_open2(ctx, codec, nullptr);
+        pthread_setname_np(pthread_self(), name);
+        return ret;
+    }
+
+    // CPU time of each thread of the process (the decoder workers included), from /proc/self/task.
+    void printThreadTimes(std::ostream& os)
+    {
+        DIR* dir = opendir("/proc/self/task");
+        if (!dir) return;
+        const long ticks = sysconf(_SC_CLK_TCK);
+        while (dirent* entry = readdir(dir)) {
+            if (entry->d_name[0] == '.') continue;
+            std::string task = std::string("/proc/self/task/") + entry->d_name;
+            std::string name;
+            std::getline(std::ifstream(task + "/comm"), name);
+            std::string stat;
+            std::getline(std::ifstream(task + "/stat"), stat);
+            // Fields after the command name, which may hold spaces: state is the 3rd, utime / stime the 14th / 15th.
+            size_t end = stat.rfind(')');
+            if (end == std::string::npos) continue;
+            std::istringstream fields(stat.substr(end + 2));
+            std::string field;
+            unsigned long long utime = 0, stime = 0;
+            for (int i = 3; i <= 15 && fields >> field; ++i) {
+                if (i == 14) utime = std::stoull(field);
+                if (i == 15) stime = std::stoull(field);
+            }
+            os << "  " << entry->d_name << " " << name << ": "
+               << (utime + stime) * 1000 / ticks << " ms CPU" << std::endl;
+        }
+        closedir(dir);
+    }
 }
 
 VideoPlayer::VideoPlayer(ST7735S& screen, uniframe::Orientation orientation)
-    : screen(screen), orientation(orientation), timeSync(), running(false)
+    : screen(screen), partialUpdater(screen), orientation(orientation), timeSync(), running(false)
 {
     // avformat_network_init();
     static TerminalRawMode terminalModeGuard;
@@ -47,6 +92,84 @@ VideoPlayer::~VideoPlayer()
     // avformat_network_deinit();
 }
 
+VideoPlayer::FramePool::~FramePool()
+{
+    for (AVFrame* frame : frames) av_frame_free(&frame);
+    av_buffer_pool_uninit(&buffers);
+}
+
+bool VideoPlayer::FramePool::init(size_t count, AVPixelFormat format, int width, int height)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    for (AVFrame* frame : frames) av_frame_free(&frame);
+    frames.clear();
+    framesFree.clear();
+    av_buffer_pool_uninit(&buffers);
+
+    int size = av_image_get_buffer_size(format, width, height, 32);
+    if (size < 0) return false;
+    // Buffers are allocated on first use and recycled from then on.
+    buffers = av_buffer_pool_init(size, av_buffer_alloc);
+    if (!buffers) return false;
+    frames.reserve(count);
+    framesFree.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        AVFrame* frame = av_frame_alloc();
+        if (!frame) return false;
+        frames.push_back(frame);
+        framesFree.push_back(frame);
+    }
+    this->format = format;
+    this->width = width;
+    this->height = height;
+    return true;
+}
+
+VideoPlayer::FramePool::Ptr VideoPlayer::FramePool::acquire(const std::atomic<bool>& running)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [&]() { return !running || !framesFree.empty(); });
+    if (!running) return Ptr(nullptr, Releaser{this});
+    AVFrame* frame = framesFree.back();
+    framesFree.pop_back();
+    lock.unlock();
+
+    frame->buf[0] = av_buffer_pool_get(buffers);
+    if (!frame->buf[0]) {
+        release(frame);
+        return Ptr(nullptr, Releaser{this});
+    }
+    av_image_fill_arrays(frame->data, frame->linesize, frame->buf[0]->data, format, width, height, 32);
+    frame->format = format;
+    frame->width = width;
+    frame->height = height;
+    return Ptr(frame, Releaser{this});
+}
+
+void VideoPlayer::FramePool::wakeAll()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+    }
+    cv.notify_all();
+}
+
+void VideoPlayer::FramePool::release(AVFrame* frame)
+{
+    // Drops the buffer reference, the pixels go back to "buffers".
+    av_frame_unref(frame);
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        framesFree.push_back(frame);
+    }
+    cv.notify_one();
+}
+
+void VideoPlayer::setDecoderOptions(const DecoderOptions& options)
+{
+    decoderOptions = options;
+}
+
 bool VideoPlayer::load(const std::string& path)
 {
     if (avformat_open_input(&formatCtx, path.c_str(), nullptr, nullptr) != 0) {
@@ -122,7 +245,7 @@ bool VideoPlayer::load(const std::string& path)
             avcodec_free_context(&ctx);
             return false;
         }
-        if (avcodec_open2(ctx, codec, nullptr) < 0) {
+        if (openCodec(ctx, codec) < 0) {
             avcodec_free_context(&ctx);
             return false;
         }
@@ -153,12 +276,23 @@ bool VideoPlayer::load(const std::string& path)
             avcodec_free_context(&ctx);
             return false;
         }
-        if (avcodec_open2(ctx, codec, nullptr) < 0) {
+        // Set explicitly: some builds default to a single thread.
+        ctx->thread_count = decoderOptions.threads > 0 ? decoderOptions.threads : std::min(av_cpu_count(), 16);
+        switch (decoderOptions.lowDelay ? DecoderOptions::Threading::Slice : decoderOptions.threading) {
+            case DecoderOptions::Threading::Frame: ctx->thread_type = FF_THREAD_FRAME; break;
+            case DecoderOptions::Threading::Slice: ctx->thread_type = FF_THREAD_SLICE; break;
+            default: ctx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE; break;
+        }
+        if (decoderOptions.lowDelay) ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+        if (openCodec(ctx, codec) < 0) {
             std::cerr << "Failed to open software decoder" << std::endl;
             avcodec_free_context(&ctx);
             return false;
         }
-        std::cout << "[Codec] Using software decoder: " << codec->name << std::endl;
+        const char* threading = ctx->active_thread_type == FF_THREAD_FRAME ? "frame" :
+                                ctx->active_thread_type == FF_THREAD_SLICE ? "slice" : "none";
+        std::cout << "[Codec] Using software decoder: " << codec->name
+                  << ", " << ctx->thread_count << " thread(s), " << threading << " threading" << std::endl;
     }
 
     codecVideo = codec;
@@ -189,42 +323,24 @@ void VideoPlayer::loopDemux()
 {
     while (running) {
         if (seekRequest) {
-            flushing.store(true);
-
-            // Awake the other threads to response the request.
-            // cvPacketVideo.notify_all();
-            // cvRawVideo.notify_all();
-
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-
-            {
-                std::lock_guard<std::mutex> lockPacket(mtxPacketVideo);
-                while (!queuePacketVideo.empty()) queuePacketVideo.pop();
-            }
-            {
-                std::lock_guard<std::mutex> lockRaw(mtxRawVideo);
-                while (!queueRawVideo.empty()) queueRawVideo.pop();
-            }
-
+            seekRequest.store(false);
             tb_t timestempTarget = av_rescale_q(seekTargetUs, AVRational{1, 1000000}, streamVideo->time_base);
             if (av_seek_frame(formatCtx, streamIndexVideo, timestempTarget, AVSEEK_FLAG_BACKWARD) < 0) {
                 std::cerr << "Seek failed" << std::endl;
-            } else {
-                avcodec_flush_buffers(codecCtxVideo);
+                continue;
             }
-
-            resetTimeRequest.store(true);
-            seekRequest.store(false);
-            flushing.store(false);
-
-            cvPacketVideo.notify_all();
-            cvRawVideo.notify_all();
+            // Nothing to wait for: whatever is queued or being decoded is now stale and gets dropped
+            // where it is met, the decoder flushes itself on the first packet of the new generation.
+            ++seekGeneration;
+            queuePacketVideo.wake();
+            queueRawVideo.wake();
             std::cout << "Seek request handled" << std::endl;
             continue;
         }
 
-        AVPacketPtr packet(av_packet_alloc());
-        if (av_read_frame(formatCtx, packet.get()) < 0) {
+        PacketItem item{AVPacketPtr(av_packet_alloc()), seekGeneration.load()};
+        AVPacket* packet = item.packet.get();
+        if (av_read_frame(formatCtx, packet) < 0) {
             std::cout << "End" << std::endl;
             break;
         }
@@ -232,25 +348,19 @@ void VideoPlayer::loopDemux()
         // Demux for the video stream
         if (packet->stream_index != streamIndexVideo) continue;
         // std::cout << "[Decode] Packet pts: " << packet->pts << " dts: " << packet->dts << std::endl;
-        std::unique_lock<std::mutex> lockPacket(mtxPacketVideo);
-        cvPacketVideo.wait(lockPacket, [&]() { return (!running) || (queuePacketVideo.size() < maxQueueSizePacketVideo);});
-        if (!running) break;
-
-        queuePacketVideo.push(std::move(packet));
-        // lockPacket.unlock();
-        cvPacketVideo.notify_one();
+        // A packet read before a seek request is of no use.
+        if (!queuePacketVideo.push(item, [&]() { return !running || seekRequest; }) && !running) break;
     }
 
     // Notify all threads to check the running status for quit.
-    cvPacketVideo.notify_all();
+    queuePacketVideo.wake();
 }
 
 void VideoPlayer::loopDecodeVideo()
 {
     AVFramePtr frameRaw(av_frame_alloc());
-    AVFramePtr frameDst(av_frame_alloc());
     SwsContext* swsCtx = nullptr;
-    if (!frameRaw || !frameDst) {
+    if (!frameRaw) {
         std::cerr << "Failed to allocate AVFrame" << std::endl;
         return;
     }
@@ -258,41 +368,64 @@ void VideoPlayer::loopDecodeVideo()
     int widthDst = screen.displayArea.displayWidth;
     int heightDst = screen.displayArea.displayHeight;
     AVPixelFormat pixelFormatDst = AV_PIX_FMT_RGB565BE;
+    // RGB444 has no packed FFmpeg format: scale to RGB24, then pack two pixels in three bytes
+    // into the (larger) RGB565 sized buffer.
+    const bool packRGB444 = screen.pixelFormat() == uniframe::PixelFormat::RGB444;
+    AVPixelFormat pixelFormatScale = packRGB444 ? AV_PIX_FMT_RGB24 : pixelFormatDst;
+    AVFramePtr frameRGB24(av_frame_alloc());
+    if (packRGB444) {
+        frameRGB24->format = AV_PIX_FMT_RGB24;
+        frameRGB24->width = widthDst;
+        frameRGB24->height = heightDst;
+        if (av_frame_get_buffer(frameRGB24.get(), 32) < 0) {
+            std::cerr << "Failed to allocate RGB24 image buffer" << std::endl;
+            return;
+        }
+    }
 
-    int ret = av_image_alloc(frameDst->data, frameDst->linesize, widthDst, heightDst, pixelFormatDst, 32);
-    if (ret < 0) {
+    // Frames queued, being filled, on display and in flight on the bus.
+    if (!framePool.init(maxQueueSizeRawVideo + 6, pixelFormatDst, widthDst, heightDst)) {
         std::cerr << "Failed to allocate destination image buffer" << std::endl;
         return;
     }
-
-    frameDst->format = pixelFormatDst;
-    frameDst->width = widthDst;
-    frameDst->height = heightDst;
+    int ret = 0;
 
     swsCtx = sws_getContext(codecCtxVideo->width, codecCtxVideo->height, codecCtxVideo->pix_fmt, 
-        widthDst, heightDst, pixelFormatDst, SWS_BICUBIC, nullptr, nullptr, nullptr);
+        widthDst, heightDst, pixelFormatScale, SWS_BICUBIC, nullptr, nullptr, nullptr);
     if (!swsCtx) {
         std::cerr << "Failed to initialize sws context" << std::endl;
         return;
     }
 
+    int skipLevelApplied = 0;
+    uint32_t decodeGeneration = seekGeneration.load();
     std::cout << "Decode pre handled" << std::endl;
 
     while (running) {
         // Acquire packet from the packet queue.
-        std::unique_lock<std::mutex> lockPacket(mtxPacketVideo);
-        cvPacketVideo.wait(lockPacket, [&]() { return (!running) || (!flushing && !queuePacketVideo.empty());});
-        if (!running) break;
-        // if (flushing) continue;
-        // if (queuePacketVideo.empty()) continue;
-
-        std::cout << "Enter decode, flushing: " << flushing << std::endl;
-        AVPacketPtr packet = std::move(queuePacketVideo.front());
-        queuePacketVideo.pop();
-        lockPacket.unlock();
-        cvPacketVideo.notify_one();
-
-        ret = avcodec_send_packet(codecCtxVideo, packet.get());
+        PacketItem item;
+        if (!queuePacketVideo.pop(item, [&]() { return !running; })) break;
+        // Read before the last seek
+        if (item.generation != seekGeneration) continue;
+        if (item.generation != decodeGeneration) {
+            avcodec_flush_buffers(codecCtxVideo);
+            decodeGeneration = item.generation;
+        }
+        AVPacket* packet = item.packet.get();
+
+#ifdef DEBUG_OUTPUT
+        std::cout << "Enter decode, generation: " << decodeGeneration << std::endl;
+#endif
+
+        us_t decodeStartUs = av_gettime();
+        int level = skipLevel.load();
+        if (level != skipLevelApplied) {
+            applySkipLevel(level);
+            skipLevelApplied = level;
+        }
+
+        ret = avcodec_send_packet(codecCtxVideo, packet);
+        decodeUs += av_gettime() - decodeStartUs;
         if (ret < 0) {
             std::cerr << "Failed to send packet to decoder" << std::endl;
             continue;
@@ -300,38 +433,51 @@ void VideoPlayer::loopDecodeVideo()
 
         // Decode and scale.
         while (ret >= 0) {
+            decodeStartUs = av_gettime();
             ret = avcodec_receive_frame(codecCtxVideo, frameRaw.get());
+            decodeUs += av_gettime() - decodeStartUs;
             if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
             if (ret < 0) {
                 std::cerr << "Failed to receive frame from decoder" << std::endl;
                 break;
             }
             // std::cout << "[Decode] Got frame pts: " << frameRaw->pts << std::endl;
-            sws_scale(swsCtx, frameRaw->data, frameRaw->linesize, 0, codecCtxVideo->height, frameDst->data, frameDst->linesize);
+            ++framesDecoded;
             int64_t pts = (frameRaw->pts != AV_NOPTS_VALUE) ? frameRaw->pts :
                 (frameRaw->best_effort_timestamp != AV_NOPTS_VALUE) ? frameRaw->best_effort_timestamp :
                 packet->pts;
+            // Already too late for the panel: skip the conversion. Not while the clock is being reset.
+            if (frameDropping && pts != AV_NOPTS_VALUE && !resetTimeRequest && !paused && timeSync.started() &&
+                decodeGeneration == displayGeneration &&
+                dropsInRow < maxDropsInRow) {
+                us_t ptsUs = av_rescale_q(pts, streamVideo->time_base, AVRational{1, 1000000});
+                if (av_gettime() - timeSync.getFrameTimeUs(ptsUs, speedFactor.load()) > lateDropUs) {
+                    ++framesDroppedDecode;
+                    ++dropsInRow;
+                    continue;
+                }
+            }
+            FramePool::Ptr frameDst = framePool.acquire(running);
+            if (!frameDst) break;
+            if (packRGB444) {
+                sws_scale(swsCtx, frameRaw->data, frameRaw->linesize, 0, codecCtxVideo->height, frameRGB24->data, frameRGB24->linesize);
+                imghandler::packRGB24ToRGB444(frameRGB24->data[0], frameRGB24->linesize[0], widthDst, heightDst, frameDst->data[0]);
+            } else {
+                sws_scale(swsCtx, frameRaw->data, frameRaw->linesize, 0, codecCtxVideo->height, frameDst->data, frameDst->linesize);
+            }
             frameDst->pts = pts;
 
-            std::unique_lock<std::mutex> lockRaw(mtxRawVideo);
-            cvRawVideo.wait(lockRaw, [&]() { return (!running) || (!flushing && queueRawVideo.size() < maxQueueSizeRawVideo);});
-            if (!running) break;
-            // if (flushing) continue;
-            queueRawVideo.push(std::move(frameDst));
-            // lockRaw.unlock();
-            cvRawVideo.notify_one();
-
-            // Re-allocate the frameDst container for another push
-            frameDst.reset(av_frame_alloc());
-            av_image_alloc(frameDst->data, frameDst->linesize, widthDst, heightDst, pixelFormatDst, 32);
-            frameDst->format = pixelFormatDst;
-            frameDst->width = widthDst;
-            frameDst->height = heightDst;
+            // Dropped (back to the pool) when a seek starts meanwhile.
+            FrameItem frameItem{std::move(frameDst), decodeGeneration};
+            if (!queueRawVideo.push(frameItem, [&]() { return !running || decodeGeneration != seekGeneration; }) && !running) break;
         }
     }
     
     sws_freeContext(swsCtx);
-    cvRawVideo.notify_all();
+    queueRawVideo.wake();
+    // The decoder workers are still alive until the codec context is freed.
+    std::cout << "[Decode] Thread CPU times:" << std::endl;
+    printThreadTimes(std::cout);
 }
 
 void VideoPlayer::loopDisplayVideo()
@@ -340,6 +486,50 @@ void VideoPlayer::loopDisplayVideo()
     const int widthDisplay = screen.displayArea.displayWidth;
     const int heightDisplay = screen.displayArea.displayHeight;
     const int bytesPerPixel = av_get_bits_per_pixel(av_pix_fmt_desc_get(AV_PIX_FMT_RGB565BE)) / 8;
+    // RGB444 frames are packed as one continuous stream by the decoder.
+    const bool packedRGB444 = screen.pixelFormat() == uniframe::PixelFormat::RGB444;
+    bool partialActive = false;
+    ST7735S::Fence fenceLast = 0;
+    // Frames submitted zero-copy, released once their fence is done
+    struct FrameInFlight {
+        ST7735S::Fence fence;
+        FramePool::Ptr frame;
+    };
+    std::vector<FrameInFlight> framesInFlight;
+    framesInFlight.reserve(4);
+    auto releaseFramesWritten = [&]() {
+        size_t done = 0;
+        while (done < framesInFlight.size() && screen.fenceDone(framesInFlight[done].fence)) ++done;
+        framesInFlight.erase(framesInFlight.begin(), framesInFlight.begin() + done);
+    };
+    // Runs of late / on time frames driving "skipLevel"
+    int lateRun = 0;
+    int onTimeRun = 0;
+    uint64_t droppedDecodeSeen = 0;
+    auto noteLateness = [&](bool late) {
+        int level = skipLevel.load();
+        if (late) {
+            onTimeRun = 0;
+            if (++lateRun >= lateRunEscalate && level < 3) {
+                skipLevel.store(level + 1);
+                lateRun = 0;
+            }
+        } else {
+            lateRun = 0;
+            if (++onTimeRun >= onTimeRunRelax && level > 0) {
+                skipLevel.store(level - 1);
+                onTimeRun = 0;
+            }
+        }
+    };
+    // Seek request to first new frame handed to the bus
+    auto noteSeekShown = [&](uint32_t generation) {
+        us_t latencyUs = av_gettime() - seekRequestedUs.load();
+        seekLatencyUs = latencyUs;
+        if (latencyUs > maxSeekLatencyUs) maxSeekLatencyUs = latencyUs;
+        ++seeksShown;
+        displayGeneration = generation;
+    };
     resetTimeRequest.store(true);
 
     std::cout << "Display pre handled" << std::endl;
@@ -349,18 +539,17 @@ void VideoPlayer::loopDisplayVideo()
             std::this_thread::sleep_for(std::chrono::milliseconds(10));
         }
 
-        std::unique_lock<std::mutex> lockRaw(mtxRawVideo);
-        cvRawVideo.wait(lockRaw, [&]() { return (!running) || (!flushing && !queueRawVideo.empty());});
-        if (!running) break;
-        // if (flushing) continue;
-        // if (queueRawVideo.empty()) continue;
-
-        std::cout << "Enter display, flushing: " << flushing << std::endl;
+        FrameItem item;
+        if (!queueRawVideo.pop(item, [&]() { return !running; })) break;
+        // Decoded before the last seek
+        if (item.generation != seekGeneration) continue;
+        FramePool::Ptr frame = std::move(item.frame);
+        const bool firstAfterSeek = item.generation != displayGeneration;
 
-        AVFramePtr frame = std::move(queueRawVideo.front());
-        queueRawVideo.pop();
-        lockRaw.unlock();
-        cvRawVideo.notify_one();
+#ifdef DEBUG_OUTPUT
+        std::cout << "Enter display, generation: " << item.generation << std::endl;
+#endif
+        releaseFramesWritten();
 
         if (frame->pts == AV_NOPTS_VALUE) {
             std::cerr << "[Display] Frame has no PTS, skipping." << std::endl;
@@ -372,35 +561,71 @@ void VideoPlayer::loopDisplayVideo()
         this->currentPtsUs = ptsFrameUs;
 
         // If need request time
-        if (resetTimeRequest.exchange(false)) {
+        if (resetTimeRequest.exchange(false) || firstAfterSeek) {
             timeSync.resetPtsBaseUs(ptsFrameUs);
         }
         us_t timeTargetUs = timeSync.getFrameTimeUs(ptsFrameUs, speedFactor.load());
+        // Have a free writer slot before pacing, so the frame goes out on time.
+        screen.waitSlot();
         us_t timeNowUs = av_gettime();
 
         if (timeTargetUs > timeNowUs) {
             std::this_thread::sleep_for(std::chrono::microseconds(timeTargetUs - timeNowUs));
         }
 
+        // Frames the decoder dropped were late too.
+        uint64_t droppedDecode = framesDroppedDecode.load();
+        bool lateDecode = droppedDecode != droppedDecodeSeen;
+        droppedDecodeSeen = droppedDecode;
+        us_t lateUs = timeNowUs - timeTargetUs;
+        if (frameDropping && !firstAfterSeek && lateUs > lateDropUs && dropsInRow < maxDropsInRow) {
+            ++framesDroppedDisplay;
+            ++dropsInRow;
+            noteLateness(true);
+            continue;
+        }
+        if (lateUs > lateToleranceUs) ++framesLate;
+        if (frameDropping) noteLateness(lateDecode || lateUs > lateToleranceUs);
+        ++framesShown;
+        dropsInRow = 0;
+
         // Prepare the frame buffer
 #ifdef DEBUG_OUTPUT
         std::cout << "[Display] Frame displayed: pts=" << frame->pts << std::endl;
 #endif
-        std::vector<uint8_t> buffer(widthDisplay * heightDisplay * bytesPerPixel);
-        if (frame->linesize[0] == widthDisplay * bytesPerPixel) {
-            std::memcpy(buffer.data(), frame->data[0], buffer.size());
-        } else {
-            for (int y = 0; y < heightDisplay; ++y) {
-                std::memcpy(buffer.data() + y * heightDisplay * bytesPerPixel,
-                            frame->data[0] + y * frame->linesize[0],
-                            widthDisplay * bytesPerPixel);
+        if (partialUpdate && !packedRGB444) {
+            // The shadow copy is stale once full frames were sent in between.
+            if (!partialActive) {
+                screen.waitFence(fenceLast);
+                partialUpdater.invalidate();
             }
+            partialActive = true;
+            partialUpdater.present(frame->data[0], frame->linesize[0]);
+            if (firstAfterSeek) noteSeekShown(item.generation);
+            continue;
         }
-
-        // Display frame
-        screen.startWrite();
-        screen.writeData(buffer.data(), buffer.size());
+        partialActive = false;
+        // The writer reads straight from the frame, padded rows become one SPI segment each.
+        const size_t frameSize = uniframe::frameBytes(screen.pixelFormat(), widthDisplay * heightDisplay);
+        const uint8_t* pixels = frame->data[0];
+        const size_t rowBytes = packedRGB444 ? frameSize : widthDisplay * bytesPerPixel;
+        const int rows = packedRGB444 ? 1 : heightDisplay;
+        const size_t stride = packedRGB444 ? frameSize : frame->linesize[0];
+
+        // Display frame, in async mode the transfer overlaps with pacing the next one.
+        ST7735S::Fence fence = screen.submitFrame(pixels, rowBytes, rows, stride);
+        if (!fence) {
+            screen.waitSlot();
+            releaseFramesWritten();
+            fence = screen.submitFrame(pixels, rowBytes, rows, stride);
+        }
+        fenceLast = fence;
+        // Keep the frame alive until the writer is done with it.
+        framesInFlight.push_back({fence, std::move(frame)});
+        if (firstAfterSeek) noteSeekShown(item.generation);
     }
+    screen.waitFence(fenceLast);
+    framesInFlight.clear();
     std::cout << "[Display] thread exit" << std::endl;
 }
 
@@ -435,6 +660,16 @@ void VideoPlayer::loopControl()
                     std::cout << "[Control] Speed: " << setSpeed(0.1) << "*" << std::endl;
                     break;
                 }
+                case 'p': {
+                    if (!setPartialUpdate(!partialUpdate)) break;
+                    std::cout << "[Control] Partial update: " << (partialUpdate ? "on" : "off") << std::endl;
+                    break;
+                }
+                case 'd': {
+                    setFrameDropping(!frameDropping);
+                    std::cout << "[Control] Frame dropping: " << (frameDropping ? "on" : "off") << std::endl;
+                    break;
+                }
                 default:
                     break;
             }
@@ -454,6 +689,11 @@ void VideoPlayer::play()
     threadDecodeVideo = std::thread(&VideoPlayer::loopDecodeVideo, this);
     threadDisplay = std::thread(&VideoPlayer::loopDisplayVideo, this);
     threadControl = std::thread(&VideoPlayer::loopControl, this);
+    // Named for the CPU time report, the decoder workers are "av-worker" (see openCodec()).
+    pthread_setname_np(threadDemux.native_handle(), "demux");
+    pthread_setname_np(threadDecodeVideo.native_handle(), "decode");
+    pthread_setname_np(threadDisplay.native_handle(), "display");
+    pthread_setname_np(threadControl.native_handle(), "control");
 }
 
 void VideoPlayer::wait()
@@ -470,16 +710,17 @@ void VideoPlayer::stop()
     running = false;
     paused = false;
 
-    cvPacketVideo.notify_all();
-    cvRawVideo.notify_all();
+    queuePacketVideo.wake();
+    queueRawVideo.wake();
+    framePool.wakeAll();
 
     if (threadDemux.joinable()) threadDemux.join();
     if (threadDecodeVideo.joinable()) threadDecodeVideo.join();
     if (threadDisplay.joinable()) threadDisplay.join();
     if (threadControl.joinable()) threadControl.join();
 
-    while (!queuePacketVideo.empty()) queuePacketVideo.pop();
-    while (!queueRawVideo.empty()) queueRawVideo.pop();
+    queuePacketVideo.clear();
+    queueRawVideo.clear();
 }
 
 void VideoPlayer::pauseResume() {
@@ -489,22 +730,25 @@ void VideoPlayer::pauseResume() {
 
 void VideoPlayer::seekForward(us_t us)
 {
-    resetTimeRequest.store(true);
+    seekRequestedUs.store(av_gettime());
     std::cout << "Enter seek forward" << std::endl;
     us_t current = currentPtsUs.load();
     us_t next = std::clamp(static_cast<us_t>(current + us), static_cast<us_t>(0), durationUs);
     seekTargetUs.store(next);
     seekRequest.store(true);
+    // The demuxer may be waiting for room in the packet ring.
+    queuePacketVideo.wake();
 }
 
 void VideoPlayer::seekBackward(us_t us)
 {
-    resetTimeRequest.store(true);
+    seekRequestedUs.store(av_gettime());
     std::cout << "Enter seek backward" << std::endl;
     us_t current = currentPtsUs.load();
     us_t next = std::clamp(static_cast<us_t>(current - us), static_cast<us_t>(0), durationUs);
     seekTargetUs.store(next);
     seekRequest.store(true);
+    queuePacketVideo.wake();
 }
 
 double VideoPlayer::setSpeed(double dFactor)
@@ -513,4 +757,43 @@ double VideoPlayer::setSpeed(double dFactor)
     double speedTarget = (speedFactor + dFactor) <= 0.1 ? 0.1 : (speedFactor + dFactor);
     speedFactor.store(speedTarget);
     return speedTarget;
+}
+
+bool VideoPlayer::setPartialUpdate(bool on)
+{
+    if (on && screen.pixelFormat() == uniframe::PixelFormat::RGB444) {
+        std::cerr << "[VideoPlayer] Partial update needs the RGB565 bus format, the bus is in RGB444" << std::endl;
+        return false;
+    }
+    partialUpdate.store(on);
+    return true;
+}
+
+void VideoPlayer::setFrameDropping(bool on)
+{
+    frameDropping.store(on);
+    if (!on) skipLevel.store(0);
+}
+
+VideoPlayer::Stats VideoPlayer::stats() const
+{
+    Stats stats;
+    stats.shown = framesShown.load();
+    stats.late = framesLate.load();
+    stats.droppedDecode = framesDroppedDecode.load();
+    stats.droppedDisplay = framesDroppedDisplay.load();
+    stats.skipLevel = skipLevel.load();
+    stats.decoded = framesDecoded.load();
+    stats.decodeUs = decodeUs.load();
+    stats.seeks = seeksShown.load();
+    stats.seekLatencyUs = seekLatencyUs.load();
+    stats.maxSeekLatencyUs = maxSeekLatencyUs.load();
+    return stats;
+}
+
+void VideoPlayer::applySkipLevel(int level)
+{
+    codecCtxVideo->skip_frame = level >= 3 ? AVDISCARD_NONKEY : level >= 1 ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+    codecCtxVideo->skip_loop_filter = level >= 2 ? AVDISCARD_ALL : AVDISCARD_DEFAULT;
+    std::cout << "[Decode] Skip level: " << level << std::endl;
 }
\ No newline at end of file
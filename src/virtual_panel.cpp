@@ -0,0 +1,207 @@
+#include "virtual_panel.hpp"
+
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+
+VirtualPanel::VirtualPanel(uint32_t sclkHz, int panelWidth, int panelHeight, int gramWidth, int gramHeight, size_t bufsiz)
+    : sclkHz(sclkHz), panelWidth(panelWidth), panelHeight(panelHeight),
+      gramWidth(gramWidth), gramHeight(gramHeight), bufsiz(bufsiz),
+      gram(static_cast<size_t>(gramWidth) * gramHeight * 3, 0)
+{
+    resetState();
+}
+
+void VirtualPanel::resetState()
+{
+    command = 0x00;
+    paramIndex = 0;
+    pixelBytesCount = 0;
+    xS = 0;
+    xE = panelWidth - 1;
+    yS = 0;
+    yE = panelHeight - 1;
+    col = 0;
+    row = 0;
+    MADCTL = 0x00;
+    // 18 bits per pixel after reset
+    COLMOD = 0x06;
+}
+
+void VirtualPanel::resetStats()
+{
+    counters = Stats();
+}
+
+void VirtualPanel::setRST(bool level)
+{
+    // Hardware reset on the falling edge, GRAM content is kept.
+    if (levelRST && !level) resetState();
+    levelRST = level;
+}
+
+void VirtualPanel::setDC(bool level)
+{
+    if (level != levelDC) ++counters.toggleDC;
+    levelDC = level;
+}
+
+void VirtualPanel::transfer(const spi_ioc_transfer* segments, size_t count)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i) total += segments[i].len;
+    if (total > bufsiz) {
+        throw std::runtime_error("SPI transfer failed");
+    }
+    ++counters.transactions;
+    counters.segments += count;
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(static_cast<uintptr_t>(segments[i].tx_buf));
+        size_t len = segments[i].len;
+        counters.busTimeUs += len * 8 * 1e6 / sclkHz;
+        if (levelDC) {
+            counters.bytesData += len;
+            for (size_t j = 0; j < len; ++j) onData(data[j]);
+        } else {
+            counters.bytesCmd += len;
+            for (size_t j = 0; j < len; ++j) onCommand(data[j]);
+        }
+    }
+}
+
+void VirtualPanel::onCommand(uint8_t cmd)
+{
+    command = cmd;
+    paramIndex = 0;
+    pixelBytesCount = 0;
+    switch (cmd) {
+    case 0x01: // SWRESET
+        resetState();
+        break;
+    case 0x2C: // RAMWR
+        col = xS;
+        row = yS;
+        ++counters.writes;
+        break;
+    default:
+        break;
+    }
+}
+
+void VirtualPanel::onData(uint8_t byte)
+{
+    switch (command) {
+    case 0x2A: // CASET
+    case 0x2B: // RASET
+        if (paramIndex < 4) params[paramIndex++] = byte;
+        if (paramIndex == 4) {
+            uint16_t start = (params[0] << 8) | params[1];
+            uint16_t end = (params[2] << 8) | params[3];
+            if (command == 0x2A) {
+                xS = start;
+                xE = end;
+            } else {
+                yS = start;
+                yE = end;
+            }
+            ++paramIndex;
+        }
+        break;
+    case 0x2C: // RAMWR
+        onPixelByte(byte);
+        break;
+    case 0x36: // MADCTL
+        if (paramIndex++ == 0) MADCTL = byte;
+        break;
+    case 0x3A: // COLMOD
+        if (paramIndex++ == 0) COLMOD = byte & 0x07;
+        break;
+    default:
+        break;
+    }
+}
+
+void VirtualPanel::onPixelByte(uint8_t byte)
+{
+    pixelBytes[pixelBytesCount++] = byte;
+    switch (COLMOD) {
+    case 0x05: { // RGB565
+        if (pixelBytesCount < 2) return;
+        uint8_t r = pixelBytes[0] >> 3;
+        uint8_t g = ((pixelBytes[0] & 0x07) << 3) | (pixelBytes[1] >> 5);
+        uint8_t b = pixelBytes[1] & 0x1F;
+        storePixel((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+        break;
+    }
+    case 0x03: // RGB444, two pixels in three bytes
+        if (pixelBytesCount < 3) return;
+        storePixel((pixelBytes[0] >> 4) * 17, (pixelBytes[0] & 0x0F) * 17, (pixelBytes[1] >> 4) * 17);
+        storePixel((pixelBytes[1] & 0x0F) * 17, (pixelBytes[2] >> 4) * 17, (pixelBytes[2] & 0x0F) * 17);
+        break;
+    default: // RGB666, one byte per channel
+        if (pixelBytesCount < 3) return;
+        storePixel(pixelBytes[0] | (pixelBytes[0] >> 6),
+                   pixelBytes[1] | (pixelBytes[1] >> 6),
+                   pixelBytes[2] | (pixelBytes[2] >> 6));
+        break;
+    }
+    pixelBytesCount = 0;
+}
+
+void VirtualPanel::storePixel(uint8_t r, uint8_t g, uint8_t b)
+{
+    // Memory access control
+    // D7 D6 D5 D4 D3  D2 D1 D0
+    // MY MX MV ML RGB MH  x  x
+    int x = col, y = row;
+    if (MADCTL & 0x20) std::swap(x, y);
+    if (MADCTL & 0x40) x = panelWidth - 1 - x;
+    if (MADCTL & 0x80) y = panelHeight - 1 - y;
+    if (MADCTL & 0x08) std::swap(r, b);
+
+    if (x >= 0 && x < gramWidth && y >= 0 && y < gramHeight) {
+        uint8_t* dst = gram.data() + (static_cast<size_t>(y) * gramWidth + x) * 3;
+        dst[0] = r;
+        dst[1] = g;
+        dst[2] = b;
+    }
+
+    // The address counter wraps inside the window.
+    if (++col > xE) {
+        col = xS;
+        if (++row > yE) row = yS;
+    }
+}
+
+uint32_t VirtualPanel::pixel(int x, int y) const
+{
+    if (x < 0 || x >= gramWidth || y < 0 || y >= gramHeight) return 0;
+    const uint8_t* p = gram.data() + (static_cast<size_t>(y) * gramWidth + x) * 3;
+    return (p[0] << 16) | (p[1] << 8) | p[2];
+}
+
+bool VirtualPanel::dumpPPM(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file) return false;
+    file << "P6\n" << panelWidth << " " << panelHeight << "\n255\n";
+    for (int y = 0; y < panelHeight; ++y) {
+        file.write(reinterpret_cast<const char*>(gram.data() + static_cast<size_t>(y) * gramWidth * 3), panelWidth * 3);
+    }
+    return static_cast<bool>(file);
+}
+
+void VirtualPanel::printStats(std::ostream& os) const
+{
+    os << "[VirtualPanel] transactions: " << counters.transactions
+       << " segments: " << counters.segments
+       << " D/C toggles: " << counters.toggleDC << "\n"
+       << "[VirtualPanel] bytes cmd: " << counters.bytesCmd
+       << " data: " << counters.bytesData
+       << " RAMWR: " << counters.writes << "\n"
+       << "[VirtualPanel] bus time: " << counters.busTimeUs / 1000.0 << " ms @ " << sclkHz << " Hz";
+    if (counters.writes > 0 && counters.busTimeUs > 0) {
+        os << " (" << counters.writes * 1e6 / counters.busTimeUs << " writes/s bus bound)";
+    }
+    os << std::endl;
+}
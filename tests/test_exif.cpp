@@ -0,0 +1,155 @@
+// extractExifThumbnail() on crafted files: offsets taken from the file must never
+// send it outside the buffer, whatever their value. Run it under ASan to be sure.
+#include "image_handler.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void check(const char* name, bool ok)
+{
+    if (!ok) {
+        ++failures;
+        std::cerr << "FAIL " << name << std::endl;
+    }
+}
+
+void putU16(std::vector<uint8_t>& out, uint16_t value, bool bigEndian)
+{
+    if (bigEndian) {
+        out.push_back(value >> 8);
+        out.push_back(value & 0xFF);
+    } else {
+        out.push_back(value & 0xFF);
+        out.push_back(value >> 8);
+    }
+}
+
+void putU32(std::vector<uint8_t>& out, uint32_t value, bool bigEndian)
+{
+    putU16(out, bigEndian ? value >> 16 : value & 0xFFFF, bigEndian);
+    putU16(out, bigEndian ? value & 0xFFFF : value >> 16, bigEndian);
+}
+
+// TIFF header pointing at IFD0 "ifd0", the caller appends the rest.
+std::vector<uint8_t> tiffHeader(uint32_t ifd0, bool bigEndian)
+{
+    std::vector<uint8_t> tiff = {bigEndian ? uint8_t('M') : uint8_t('I'), bigEndian ? uint8_t('M') : uint8_t('I')};
+    putU16(tiff, 42, bigEndian);
+    putU32(tiff, ifd0, bigEndian);
+    return tiff;
+}
+
+// SOI, APP1 "Exif" holding "tiff", EOI; exactly sized so ASan sees any overread.
+std::vector<uint8_t> jpegWithExif(const std::vector<uint8_t>& tiff)
+{
+    std::vector<uint8_t> jpeg = {0xFF, 0xD8, 0xFF, 0xE1};
+    putU16(jpeg, static_cast<uint16_t>(2 + 6 + tiff.size()), true);
+    const char exif[] = "Exif\0";
+    jpeg.insert(jpeg.end(), exif, exif + 6);
+    jpeg.insert(jpeg.end(), tiff.begin(), tiff.end());
+    jpeg.push_back(0xFF);
+    jpeg.push_back(0xD9);
+    return jpeg;
+}
+
+bool extract(const std::vector<uint8_t>& jpeg, const uint8_t*& thumb, size_t& thumbLen)
+{
+    // Heap copy of the exact size, no slack behind the last byte.
+    std::vector<uint8_t> copy(jpeg);
+    copy.shrink_to_fit();
+    thumb = nullptr;
+    thumbLen = 0;
+    bool found = imghandler::extractExifThumbnail(copy.data(), copy.size(), thumb, thumbLen);
+    if (found) thumb = jpeg.data() + (thumb - copy.data());
+    return found;
+}
+
+bool rejects(const std::vector<uint8_t>& jpeg)
+{
+    const uint8_t* thumb;
+    size_t thumbLen;
+    return !extract(jpeg, thumb, thumbLen);
+}
+
+// IFD0 without entries, then IFD1 at "ifd1" holding "entries" (tag, type, value).
+std::vector<uint8_t> withIfd1(uint32_t ifd1, uint16_t count, const std::vector<uint32_t>& entries, bool bigEndian)
+{
+    std::vector<uint8_t> tiff = tiffHeader(8, bigEndian);
+    putU16(tiff, 0, bigEndian);
+    putU32(tiff, ifd1, bigEndian);
+    putU16(tiff, count, bigEndian);
+    for (size_t i = 0; i + 2 < entries.size(); i += 3) {
+        putU16(tiff, static_cast<uint16_t>(entries[i]), bigEndian);
+        putU16(tiff, static_cast<uint16_t>(entries[i + 1]), bigEndian);
+        putU32(tiff, 1, bigEndian);
+        putU32(tiff, entries[i + 2], bigEndian);
+    }
+    putU32(tiff, 0, bigEndian);
+    return tiff;
+}
+
+}
+
+int main()
+{
+    // 28 bytes: APP1 Exif, "MM" header, IFD0 offset 0xFFFFFFFF (used to wrap "ifd + 2").
+    const std::vector<uint8_t> crafted = {
+        0xFF, 0xD8, 0xFF, 0xE1, 0x00, 0x16, 'E', 'x', 'i', 'f', 0x00, 0x00, 'M', 'M',
+        0x00, 0x2A, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xD9};
+    check("IFD0 offset 0xFFFFFFFF, 28 bytes file", rejects(crafted));
+
+    for (bool bigEndian : {true, false}) {
+        const char* order = bigEndian ? " (MM)" : " (II)";
+        auto name = [&](const char* what) { return std::string(what) + order; };
+
+        for (uint32_t ifd0 : {0xFFFFFFFFu, 0xFFFFFFFEu, 0xFFFFFFF0u, 0x80000000u, 0xFFFFu}) {
+            std::vector<uint8_t> tiff = tiffHeader(ifd0, bigEndian);
+            tiff.resize(16, 0);
+            check(name("IFD0 offset past the end").c_str(), rejects(jpegWithExif(tiff)));
+        }
+        // Entry count running IFD0 (and its "next" link) past the end
+        {
+            std::vector<uint8_t> tiff = tiffHeader(8, bigEndian);
+            putU16(tiff, 0xFFFF, bigEndian);
+            tiff.resize(32, 0);
+            check(name("IFD0 entry count past the end").c_str(), rejects(jpegWithExif(tiff)));
+        }
+        for (uint32_t ifd1 : {0xFFFFFFFFu, 0xFFFFFFFEu, 0xFFFFFFF4u}) {
+            check(name("IFD1 offset past the end").c_str(), rejects(jpegWithExif(withIfd1(ifd1, 0, {}, bigEndian))));
+        }
+        // IFD1 claims more entries than the segment holds
+        check(name("IFD1 entry count past the end").c_str(),
+              rejects(jpegWithExif(withIfd1(14, 0xFFFF, {0x0201, 4, 8, 0x0202, 4, 4}, bigEndian))));
+        // Thumbnail offset / length outside the segment
+        check(name("thumbnail offset past the end").c_str(),
+              rejects(jpegWithExif(withIfd1(14, 2, {0x0201, 4, 0xFFFFFFFE, 0x0202, 4, 4}, bigEndian))));
+        check(name("thumbnail length past the end").c_str(),
+              rejects(jpegWithExif(withIfd1(14, 2, {0x0201, 4, 8, 0x0202, 4, 0xFFFFFFFF}, bigEndian))));
+
+        // A well formed thumbnail is still found: IFD1 at 14 has 2 entries, then the
+        // next link, so the thumbnail starts at 14 + 2 + 24 + 4 = 44.
+        std::vector<uint8_t> tiff = withIfd1(14, 2, {0x0201, 4, 44, 0x0202, 4, 6}, bigEndian);
+        const std::vector<uint8_t> thumbnail = {0xFF, 0xD8, 0x01, 0x02, 0xFF, 0xD9};
+        tiff.insert(tiff.end(), thumbnail.begin(), thumbnail.end());
+        std::vector<uint8_t> jpeg = jpegWithExif(tiff);
+        const uint8_t* thumb;
+        size_t thumbLen;
+        bool found = extract(jpeg, thumb, thumbLen);
+        check(name("valid thumbnail found").c_str(),
+              found && thumbLen == thumbnail.size() && std::equal(thumbnail.begin(), thumbnail.end(), thumb));
+    }
+
+    if (failures) {
+        std::cerr << failures << " EXIF check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "EXIF thumbnail extraction rejects every out of range offset" << std::endl;
+    return 0;
+}
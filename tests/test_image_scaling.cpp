@@ -0,0 +1,165 @@
+// RowScaler (box filter), scaleToRGB565 / scaleToRGB444 and packRGB24ToRGB444 against
+// straightforward per-pixel references, bit for bit. Odd sizes, up and down scaling,
+// padded source strides and odd pixel counts (the RGB444 padding pixel) included.
+#include "image_handler.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void check(const std::string& name, bool ok)
+{
+    if (!ok && ++failures <= 20) std::cerr << "FAIL " << name << std::endl;
+}
+
+std::string sizes(int sw, int sh, int dw, int dh)
+{
+    return std::to_string(sw) + "x" + std::to_string(sh) + " -> " + std::to_string(dw) + "x" + std::to_string(dh);
+}
+
+imghandler::ImageRGB24 randomImage(std::mt19937& rng, int width, int height)
+{
+    imghandler::ImageRGB24 image{width, height, std::vector<uint8_t>(static_cast<size_t>(width) * height * 3)};
+    for (auto& byte : image.data) byte = static_cast<uint8_t>(rng());
+    return image;
+}
+
+// Output pixel (x, y) is the rounded mean of the source box
+// [x * sw / dw, (x + 1) * sw / dw) x [y * sh / dh, (y + 1) * sh / dh), at least one pixel wide.
+std::vector<uint8_t> boxReference(const imghandler::ImageRGB24& src, int dw, int dh)
+{
+    std::vector<uint8_t> dst(static_cast<size_t>(dw) * dh * 3);
+    for (int y = 0; y < dh; ++y) {
+        int y0 = static_cast<int>(static_cast<int64_t>(y) * src.height / dh);
+        int y1 = std::max(y0 + 1, static_cast<int>(static_cast<int64_t>(y + 1) * src.height / dh));
+        for (int x = 0; x < dw; ++x) {
+            int x0 = static_cast<int>(static_cast<int64_t>(x) * src.width / dw);
+            int x1 = std::max(x0 + 1, static_cast<int>(static_cast<int64_t>(x + 1) * src.width / dw));
+            uint32_t count = (y1 - y0) * (x1 - x0);
+            for (int c = 0; c < 3; ++c) {
+                uint32_t sum = 0;
+                for (int sy = y0; sy < y1; ++sy) {
+                    for (int sx = x0; sx < x1; ++sx) sum += src.data[(static_cast<size_t>(sy) * src.width + sx) * 3 + c];
+                }
+                dst[(static_cast<size_t>(y) * dw + x) * 3 + c] = static_cast<uint8_t>((sum + count / 2) / count);
+            }
+        }
+    }
+    return dst;
+}
+
+std::vector<uint8_t> rgb565Reference(const std::vector<uint8_t>& rgb)
+{
+    std::vector<uint8_t> out;
+    for (size_t i = 0; i + 2 < rgb.size(); i += 3) {
+        uint16_t color = ((rgb[i] & 0xF8) << 8) | ((rgb[i + 1] & 0xFC) << 3) | (rgb[i + 2] >> 3);
+        out.push_back(color >> 8);
+        out.push_back(color & 0xFF);
+    }
+    return out;
+}
+
+// Pixels in order as 12 bits values, an odd count repeats the first pixel, then two per three bytes.
+std::vector<uint8_t> rgb444Reference(const uint8_t* src, size_t stride, int width, int height)
+{
+    std::vector<uint16_t> pixels;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const uint8_t* p = src + y * stride + x * 3;
+            pixels.push_back(((p[0] >> 4) << 8) | ((p[1] >> 4) << 4) | (p[2] >> 4));
+        }
+    }
+    if (pixels.size() % 2) pixels.push_back(pixels.front());
+    std::vector<uint8_t> out;
+    for (size_t i = 0; i < pixels.size(); i += 2) {
+        uint32_t pair = (static_cast<uint32_t>(pixels[i]) << 12) | pixels[i + 1];
+        out.push_back(pair >> 16);
+        out.push_back((pair >> 8) & 0xFF);
+        out.push_back(pair & 0xFF);
+    }
+    return out;
+}
+
+void testRowScaler(std::mt19937& rng, int sw, int sh, int dw, int dh)
+{
+    imghandler::ImageRGB24 src = randomImage(rng, sw, sh);
+    std::vector<uint8_t> out(static_cast<size_t>(dw) * dh * 3, 0);
+    int nextRow = 0;
+    bool ordered = true;
+    imghandler::RowScaler scaler(sw, sh, dw, dh, [&](int y, const uint8_t* rgb) {
+        ordered = ordered && y == nextRow++;
+        std::copy(rgb, rgb + dw * 3, out.begin() + static_cast<size_t>(y) * dw * 3);
+    });
+    for (int y = 0; y < sh; ++y) scaler.pushRow(src.data.data() + static_cast<size_t>(y) * sw * 3);
+    check("RowScaler rows in order, once: " + sizes(sw, sh, dw, dh), ordered && nextRow == dh);
+    check("RowScaler pixels: " + sizes(sw, sh, dw, dh), out == boxReference(src, dw, dh));
+
+    imghandler::ImageRGB565 rgb565;
+    check("scaleToRGB565: " + sizes(sw, sh, dw, dh), imghandler::scaleToRGB565(src, rgb565, dw, dh) &&
+          rgb565.width == dw && rgb565.height == dh && rgb565.data == rgb565Reference(boxReference(src, dw, dh)));
+
+    imghandler::ImageRGB444 rgb444;
+    std::vector<uint8_t> box = boxReference(src, dw, dh);
+    check("scaleToRGB444: " + sizes(sw, sh, dw, dh), imghandler::scaleToRGB444(src, rgb444, dw, dh) &&
+          rgb444.width == dw && rgb444.height == dh && rgb444.data == rgb444Reference(box.data(), dw * 3, dw, dh));
+}
+
+void testPack(std::mt19937& rng, int width, int height, size_t padding)
+{
+    const size_t stride = width * 3 + padding;
+    std::vector<uint8_t> src(stride * height);
+    for (auto& byte : src) byte = static_cast<uint8_t>(rng());
+    const size_t len = (static_cast<size_t>(width) * height + 1) / 2 * 3;
+    const size_t guard = 16;
+    std::vector<uint8_t> dst(len + guard, 0xA5);
+    imghandler::packRGB24ToRGB444(src.data(), stride, width, height, dst.data());
+
+    std::string name = "packRGB24ToRGB444 " + std::to_string(width) + "x" + std::to_string(height) + ", padding " + std::to_string(padding);
+    check(name, std::vector<uint8_t>(dst.begin(), dst.begin() + len) == rgb444Reference(src.data(), stride, width, height));
+    check(name + ", nothing written past the end", std::all_of(dst.begin() + len, dst.end(), [](uint8_t b) { return b == 0xA5; }));
+}
+
+}
+
+int main()
+{
+    std::mt19937 rng(7735);
+
+    // Down, up, mixed and identity, odd sizes included.
+    const int cases[][4] = {
+        {1, 1, 1, 1}, {1, 1, 5, 3}, {7, 5, 7, 5}, {37, 23, 8, 5}, {8, 5, 37, 23}, {300, 200, 128, 160},
+        {160, 128, 128, 160}, {640, 480, 128, 96}, {129, 161, 128, 160}, {3, 97, 17, 2}, {1000, 3, 7, 11},
+    };
+    for (const auto& c : cases) testRowScaler(rng, c[0], c[1], c[2], c[3]);
+    for (int i = 0; i < 40; ++i) {
+        testRowScaler(rng, 1 + rng() % 200, 1 + rng() % 200, 1 + rng() % 130, 1 + rng() % 170);
+    }
+
+    imghandler::ImageRGB24 src = randomImage(rng, 4, 4);
+    imghandler::ImageRGB565 rgb565;
+    check("scaleToRGB565 rejects an empty target", !imghandler::scaleToRGB565(src, rgb565, 0, 10));
+
+    // Odd widths, odd pixel counts (the padding pixel repeats the first one), padded strides.
+    for (int width = 1; width <= 9; ++width) {
+        for (int height = 1; height <= 5; ++height) {
+            for (size_t padding : {0, 1, 5}) testPack(rng, width, height, padding);
+        }
+    }
+    imghandler::ImageRGB444 rgb444;
+    src = randomImage(rng, 5, 3);
+    check("convertToRGB444", imghandler::convertToRGB444(src, rgb444) && rgb444.data == rgb444Reference(src.data.data(), 15, 5, 3));
+
+    if (failures) {
+        std::cerr << failures << " image scaling check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "Box filter, RGB565 / RGB444 scaling and packing bit-exact against the references" << std::endl;
+    return 0;
+}
@@ -0,0 +1,113 @@
+// PanelGroup over VirtualPanels: two panels sharing a bus and one alone, with a
+// spidev bufsiz larger than a frame. Every frame must land whole, cut into the same
+// number of rounds of at most "quantum" bytes, whatever the bufsiz.
+#include "panel_group.hpp"
+#include "virtual_panel.hpp"
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+template <typename T>
+void checkEqual(const std::string& name, T value, T expected)
+{
+    if (value != expected) {
+        ++failures;
+        std::cerr << "FAIL " << name << ": " << value << ", expected " << expected << std::endl;
+    }
+}
+
+struct Board {
+    VirtualPanel* panel;
+    std::unique_ptr<ST7735S> screen;
+};
+
+Board makeBoard(size_t bufsiz)
+{
+    auto owned = std::make_unique<VirtualPanel>(32000000, 128, 160, 132, 162, bufsiz);
+    VirtualPanel* panel = owned.get();
+    auto screen = std::make_unique<ST7735S>(std::move(owned));
+    screen->setPixelFormat(uniframe::PixelFormat::RGB565);
+    screen->rangeReset();
+    return {panel, std::move(screen)};
+}
+
+std::vector<uint8_t> pattern(size_t len, uint32_t seed)
+{
+    std::vector<uint8_t> bytes(len);
+    for (size_t i = 0; i < len; ++i) bytes[i] = static_cast<uint8_t>((i * 2654435761u + seed) >> 11);
+    return bytes;
+}
+
+// The first "len" bytes of RGB565 data are the first pixels of the panel, row by row.
+void checkGram(const std::string& name, const VirtualPanel& panel, const std::vector<uint8_t>& data)
+{
+    for (size_t i = 0; i + 1 < data.size(); i += 2) {
+        uint16_t color = (data[i] << 8) | data[i + 1];
+        uint32_t r = color >> 11, g = (color >> 5) & 0x3F, b = color & 0x1F;
+        uint32_t expected = ((r << 3 | r >> 2) << 16) | ((g << 2 | g >> 4) << 8) | (b << 3 | b >> 2);
+        int x = static_cast<int>(i / 2 % 128), y = static_cast<int>(i / 2 / 128);
+        if (panel.pixel(x, y) != expected) {
+            ++failures;
+            std::cerr << "FAIL " << name << ": pixel " << x << "," << y << std::endl;
+            return;
+        }
+    }
+}
+
+}
+
+int main()
+{
+    const size_t bufsiz = 65536;
+    const size_t full = 128 * 160 * 2;
+    std::vector<Board> boards;
+    for (int i = 0; i < 3; ++i) boards.push_back(makeBoard(bufsiz));
+
+    PanelGroup group;
+    group.addPanel(*boards[0].screen, 0);
+    group.addPanel(*boards[1].screen, 0);
+    group.addPanel(*boards[2].screen, 1);
+
+    for (int pass = 0; pass < 2; ++pass) {
+        std::vector<std::vector<uint8_t>> data = {pattern(full, pass), pattern(full / 2, pass + 7), pattern(full, pass + 13)};
+        for (auto& board : boards) board.panel->resetStats();
+        group.present({{data[0].data(), data[0].size()}, {data[1].data(), data[1].size()}, {data[2].data(), data[2].size()}});
+        group.wait();
+
+        // 40960 bytes in 2048 byte rounds: 20 rounds, the half frame goes 1024 bytes a round.
+        const uint64_t rounds = full / group.quantum;
+        for (size_t i = 0; i < boards.size(); ++i) {
+            std::string name = "pass " + std::to_string(pass) + ", panel " + std::to_string(i);
+            checkGram(name, *boards[i].panel, data[i]);
+            checkEqual(name + " data bytes", boards[i].panel->stats().bytesData, uint64_t(data[i].size()));
+            checkEqual(name + " messages", boards[i].panel->stats().transactions, 1 + rounds);
+        }
+        std::cout << "Pass " << pass << ": skew " << group.lastSkewUs() << " us" << std::endl;
+    }
+
+    // A quantum larger than the frames: one piece per panel (the message limit caps it too).
+    group.quantum = bufsiz * 4;
+    std::vector<uint8_t> data = pattern(full, 99);
+    for (auto& board : boards) board.panel->resetStats();
+    group.present({{data.data(), data.size()}, {data.data(), data.size()}, {data.data(), data.size()}});
+    group.wait();
+    for (size_t i = 0; i < boards.size(); ++i) {
+        std::string name = "large quantum, panel " + std::to_string(i);
+        checkGram(name, *boards[i].panel, data);
+        checkEqual(name + " messages", boards[i].panel->stats().transactions, uint64_t(2));
+    }
+
+    if (failures) {
+        std::cerr << failures << " PanelGroup check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "PanelGroup: frames whole, interleaved by quantum" << std::endl;
+    return 0;
+}
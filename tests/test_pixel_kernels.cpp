@@ -0,0 +1,92 @@
+// Every kernel variant the CPU supports against the scalar reference, bit for bit.
+// Lengths 0..maxPixels cover the vector blocks and every tail; the buffers start at
+// unaligned offsets and guard bytes around the output catch writes past the end.
+#include "pixel_kernels.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr size_t maxPixels = 300;
+constexpr size_t maxOffset = 7;
+constexpr size_t guard = 64;
+constexpr uint8_t guardByte = 0xA5;
+
+int failures = 0;
+
+void fail(const char* variant, const char* kernel, size_t len, size_t srcOffset, size_t dstOffset)
+{
+    if (++failures <= 20) {
+        std::cerr << "FAIL " << variant << " " << kernel << ": length " << len
+                  << ", src offset " << srcOffset << ", dst offset " << dstOffset << std::endl;
+    }
+}
+
+// Output of "run" equals the reference's, and nothing around it was touched.
+template <typename Run>
+void compare(const char* variant, const char* kernel, size_t len, size_t srcOffset, size_t dstOffset,
+             size_t dstBytes, Run run)
+{
+    std::vector<uint8_t> expected(dstOffset + dstBytes + guard, guardByte);
+    std::vector<uint8_t> actual(expected.size(), guardByte);
+    run(true, expected.data() + dstOffset);
+    run(false, actual.data() + dstOffset);
+    if (expected != actual) fail(variant, kernel, len, srcOffset, dstOffset);
+}
+
+}
+
+int main()
+{
+    std::mt19937 rng(7735);
+    std::vector<uint8_t> source((maxPixels + maxOffset) * 4);
+    for (auto& b : source) b = static_cast<uint8_t>(rng());
+
+    const pixkernel::Kernels& reference = pixkernel::available().front();
+    for (const pixkernel::Kernels& k : pixkernel::available()) {
+        int failuresBefore = failures;
+        for (size_t len = 0; len <= maxPixels; ++len) {
+            for (size_t srcOffset = 0; srcOffset <= maxOffset; ++srcOffset) {
+                const uint8_t* src = source.data() + srcOffset;
+                size_t dstOffset = (len + srcOffset) % (maxOffset + 1);
+                auto pick = [&](bool ref, auto member) { return ref ? reference.*member : k.*member; };
+
+                compare(k.name, "rgb888ToRGB565BE", len, srcOffset, dstOffset, len * 2, [&](bool ref, uint8_t* dst) {
+                    pick(ref, &pixkernel::Kernels::rgb888ToRGB565BE)(src, dst, len);
+                });
+                compare(k.name, "rgb888ToRGB565LE", len, srcOffset, dstOffset, len * 2, [&](bool ref, uint8_t* dst) {
+                    pick(ref, &pixkernel::Kernels::rgb888ToRGB565LE)(src, dst, len);
+                });
+                compare(k.name, "rgbaToRGB565BE", len, srcOffset, dstOffset, len * 2, [&](bool ref, uint8_t* dst) {
+                    pick(ref, &pixkernel::Kernels::rgbaToRGB565BE)(src, dst, len);
+                });
+                compare(k.name, "byteswap16", len, srcOffset, dstOffset, len * 2, [&](bool ref, uint8_t* dst) {
+                    pick(ref, &pixkernel::Kernels::byteswap16)(src, dst, len);
+                });
+                // In place is allowed too
+                compare(k.name, "byteswap16 in place", len, srcOffset, dstOffset, len * 2, [&](bool ref, uint8_t* dst) {
+                    std::memcpy(dst, src, len * 2);
+                    pick(ref, &pixkernel::Kernels::byteswap16)(dst, dst, len);
+                });
+                // Byte lengths, patterns of one RGB565 pixel up to a few RGB444 pairs
+                for (size_t patternLen = 1; patternLen <= 9; ++patternLen) {
+                    compare(k.name, "fill", len, srcOffset, dstOffset, len, [&](bool ref, uint8_t* dst) {
+                        pick(ref, &pixkernel::Kernels::fill)(dst, len, src, patternLen);
+                    });
+                }
+            }
+        }
+        std::cout << k.name << (failures == failuresBefore ? " ok" : " MISMATCH") << std::endl;
+    }
+    if (failures) {
+        std::cerr << failures << " mismatch(es)" << std::endl;
+        return 1;
+    }
+    std::cout << "Kernels bit-exact against scalar (" << pixkernel::available().size() << " variants, in use: "
+              << pixkernel::active() << ")" << std::endl;
+    return 0;
+}
@@ -0,0 +1,148 @@
+// ST7735S driven over a VirtualPanel: what lands in the simulated GRAM and how many
+// bytes / messages it takes, then the effective frame rate of the host side.
+#include "st7735s.hpp"
+#include "virtual_panel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void check(const char* name, bool ok)
+{
+    if (!ok) {
+        ++failures;
+        std::cerr << "FAIL " << name << std::endl;
+    }
+}
+
+template <typename T>
+void checkEqual(const char* name, T value, T expected)
+{
+    if (value != expected) {
+        ++failures;
+        std::cerr << "FAIL " << name << ": " << value << ", expected " << expected << std::endl;
+    }
+}
+
+// RGB888 the panel shows for a RGB565 value (bit replication, as the glass does).
+uint32_t expand565(uint16_t color)
+{
+    uint32_t r = color >> 11, g = (color >> 5) & 0x3F, b = color & 0x1F;
+    return ((r << 3 | r >> 2) << 16) | ((g << 2 | g >> 4) << 8) | (b << 3 | b >> 2);
+}
+
+// Pixels of the window "x0, y0, width, height" are the expected RGB565 values.
+bool windowHolds(const VirtualPanel& panel, int x0, int y0, int width, int height, const std::vector<uint16_t>& pixels)
+{
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            if (panel.pixel(x0 + x, y0 + y) != expand565(pixels[static_cast<size_t>(y) * width + x])) return false;
+        }
+    }
+    return true;
+}
+
+std::vector<uint8_t> toBigEndian(const std::vector<uint16_t>& pixels)
+{
+    std::vector<uint8_t> bytes;
+    for (uint16_t pixel : pixels) {
+        bytes.push_back(pixel >> 8);
+        bytes.push_back(pixel & 0xFF);
+    }
+    return bytes;
+}
+
+}
+
+int main()
+{
+    const size_t bufsiz = 4096;
+    auto owned = std::make_unique<VirtualPanel>(32000000, 128, 160, 132, 162, bufsiz);
+    VirtualPanel& panel = *owned;
+    ST7735S screen(std::move(owned));
+    screen.init();
+    screen.orientationSet(uniframe::Orientation::Portrait);
+    const int width = screen.screenWidth, height = screen.screenHeight;
+    const size_t frameBytes = static_cast<size_t>(width) * height * 2;
+
+    // Full screen fill: CASET / RASET / RAMWR, then the frame cut at bufsiz.
+    panel.resetStats();
+    screen.fillWith(0x3C78B4);
+    uint16_t fill565 = ((0x3C & 0xF8) << 8) | ((0x78 & 0xFC) << 3) | (0xB4 >> 3);
+    check("fill: whole screen", windowHolds(panel, 0, 0, width, height, std::vector<uint16_t>(width * height, fill565)));
+    checkEqual("fill: command bytes", panel.stats().bytesCmd, uint64_t(3));
+    checkEqual("fill: data bytes", panel.stats().bytesData, uint64_t(8 + frameBytes));
+    checkEqual("fill: RAMWR", panel.stats().writes, uint64_t(1));
+
+    // Full frame from one buffer: one command message, then transfersPerFrame() data messages.
+    std::vector<uint16_t> frame(static_cast<size_t>(width) * height);
+    for (size_t i = 0; i < frame.size(); ++i) frame[i] = static_cast<uint16_t>(i * 2654435761u >> 7);
+    std::vector<uint8_t> frameBE = toBigEndian(frame);
+    panel.resetStats();
+    screen.writeFrame(frameBE.data(), frameBE.size());
+    check("frame: whole screen", windowHolds(panel, 0, 0, width, height, frame));
+    checkEqual("frame: data bytes", panel.stats().bytesData, uint64_t(frameBytes));
+    checkEqual("frame: messages", panel.stats().transactions, uint64_t(1 + screen.transfersPerFrame(frameBytes)));
+    checkEqual("frame: transfers per frame", screen.transfersPerFrame(frameBytes), (frameBytes + bufsiz - 1) / bufsiz);
+
+    // Sub window from strided rows (an AVFrame with padding), nothing outside it changes.
+    const int winX = 10, winY = 20, winW = 33, winH = 17;
+    const size_t stride = winW * 2 + 14;
+    std::vector<uint16_t> window(static_cast<size_t>(winW) * winH);
+    std::vector<uint8_t> strided(stride * winH, 0xEE);
+    for (size_t i = 0; i < window.size(); ++i) {
+        window[i] = static_cast<uint16_t>(0xF81F ^ (i * 40503u));
+        strided[(i / winW) * stride + (i % winW) * 2] = window[i] >> 8;
+        strided[(i / winW) * stride + (i % winW) * 2 + 1] = window[i] & 0xFF;
+    }
+    screen.rangeSet(winX, winX + winW - 1, winY, winY + winH - 1);
+    panel.resetStats();
+    screen.writeFrame(strided.data(), winW * 2, winH, stride);
+    check("window: pixels", windowHolds(panel, winX, winY, winW, winH, window));
+    check("window: left untouched", panel.pixel(winX - 1, winY) == expand565(frame[winY * width + winX - 1]) &&
+                                    panel.pixel(winX + winW, winY + winH - 1) == expand565(frame[(winY + winH - 1) * width + winX + winW]));
+    checkEqual("window: data bytes", panel.stats().bytesData, uint64_t(winW * 2 * winH));
+    checkEqual("window: segments", panel.stats().segments, uint64_t(1 + winH));
+
+    // Async writer: the frame is in GRAM once its fence is done.
+    screen.rangeReset();
+    screen.enableAsync(2);
+    std::reverse(frame.begin(), frame.end());
+    frameBE = toBigEndian(frame);
+    ST7735S::Fence fence = screen.submitFrame(frameBE.data(), frameBE.size());
+    check("async: fence", fence != 0);
+    screen.waitFence(fence);
+    screen.disableAsync();
+    check("async: whole screen", windowHolds(panel, 0, 0, width, height, frame));
+
+    // RGB444: two pixels in three bytes, a quarter less on the bus.
+    screen.setPixelFormat(uniframe::PixelFormat::RGB444);
+    panel.resetStats();
+    screen.fillWith(0xF0A050);
+    checkEqual("rgb444: data bytes", panel.stats().bytesData, uint64_t(8 + frameBytes * 3 / 4));
+    check("rgb444: color", panel.pixel(0, 0) == 0xFFAA55 && panel.pixel(width - 1, height - 1) == 0xFFAA55);
+    screen.setPixelFormat(uniframe::PixelFormat::RGB565);
+
+    // Host side cost of a full frame, the bus time is what the wire would take at SCLK.
+    const int frames = 200;
+    panel.resetStats();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; ++i) screen.writeFrame(frameBE.data(), frameBE.size());
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Effective: " << frames / seconds << " fps on the host, "
+              << frames * 1e6 / panel.stats().busTimeUs << " fps bus bound at 32 MHz" << std::endl;
+
+    if (failures) {
+        std::cerr << failures << " VirtualPanel check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "ST7735S over VirtualPanel: GRAM and bus traffic as expected" << std::endl;
+    return 0;
+}